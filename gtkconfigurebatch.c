@@ -0,0 +1,232 @@
+/* gtkconfigurebatch.c
+ * Copyright (C) 2008 Free Software Foundation, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Each gdk_window_move_resize is an X request, and a layout pass can
+   move the same window several times, or move it back where it was.
+   Between _gtk_configure_batch_begin and _gtk_configure_batch_end only
+   the last geometry of each window is remembered; the windows are then
+   configured once, and only if their geometry changed.  Children are
+   configured before their parents, so that the area that a parent
+   uncovers when it grows is already covered by its children and
+   only they get an expose.  Only used from the GTK+ thread.  */
+
+#include <gdk/gdk.h>
+#include "gtkconfigurebatch.h"
+
+typedef struct _GtkConfigureRequest GtkConfigureRequest;
+
+struct _GtkConfigureRequest
+{
+  GdkWindow *window;
+  GdkRectangle geometry;
+
+  /* For sorting: the depth of the window in the hierarchy, and the
+     order in which the windows were first configured.  */
+  gint depth;
+  guint serial;
+};
+
+static gint		batch_depth;
+static GHashTable	*batch_requests;
+static guint		batch_serial;
+static guint		stats_calls;
+static guint		stats_requests;
+
+/**
+ * gtk_configure_batch_get_stats:
+ * @n_calls: return location for the number of configure calls, or %NULL
+ * @n_requests: return location for the number of X requests, or %NULL
+ *
+ * Returns how many times the widgets asked to move or resize one of
+ * their windows since the statistics were last reset, and how many
+ * X requests that took.  The difference is the number of requests
+ * that were saved.
+ **/
+void
+gtk_configure_batch_get_stats (guint *n_calls,
+			       guint *n_requests)
+{
+  if (n_calls)
+    *n_calls = stats_calls;
+  if (n_requests)
+    *n_requests = stats_requests;
+}
+
+/**
+ * gtk_configure_batch_reset_stats:
+ *
+ * Resets the counters returned by gtk_configure_batch_get_stats.
+ **/
+void
+gtk_configure_batch_reset_stats (void)
+{
+  stats_calls = stats_requests = 0;
+}
+
+static void
+gtk_configure_batch_apply (GdkWindow          *window,
+			   const GdkRectangle *geometry)
+{
+  gint x, y, width, height;
+
+  /* GDK remembers the geometry of its windows, so this is free.  */
+  gdk_window_get_position (window, &x, &y);
+  gdk_drawable_get_size (window, &width, &height);
+  if (geometry->x == x && geometry->y == y)
+    {
+      if (geometry->width == width && geometry->height == height)
+	return;
+
+      gdk_window_resize (window, geometry->width, geometry->height);
+    }
+  else if (geometry->width == width && geometry->height == height)
+    gdk_window_move (window, geometry->x, geometry->y);
+  else
+    gdk_window_move_resize (window, geometry->x, geometry->y,
+			    geometry->width, geometry->height);
+
+  stats_requests++;
+}
+
+static void
+gtk_configure_request_free (gpointer p)
+{
+  GtkConfigureRequest *request = p;
+
+  g_object_unref (request->window);
+  g_slice_free (GtkConfigureRequest, request);
+}
+
+/* Deepest first, then in the order of the calls.  */
+static gint
+gtk_configure_request_compare (gconstpointer a,
+			       gconstpointer b)
+{
+  const GtkConfigureRequest *request_a = *(GtkConfigureRequest **) a;
+  const GtkConfigureRequest *request_b = *(GtkConfigureRequest **) b;
+
+  if (request_a->depth != request_b->depth)
+    return request_b->depth - request_a->depth;
+
+  return request_a->serial < request_b->serial ? -1 : 1;
+}
+
+static void
+gtk_configure_batch_add_request (gpointer key,
+				 gpointer value,
+				 gpointer user_data)
+{
+  GtkConfigureRequest *request = value;
+  GdkWindow *parent;
+
+  request->depth = 0;
+  for (parent = gdk_window_get_parent (request->window); parent;
+       parent = gdk_window_get_parent (parent))
+    request->depth++;
+
+  g_ptr_array_add (user_data, request);
+}
+
+static void
+gtk_configure_batch_flush (void)
+{
+  GtkConfigureRequest *request;
+  GPtrArray *requests;
+  guint i;
+
+  if (!batch_requests || g_hash_table_size (batch_requests) == 0)
+    return;
+
+  requests = g_ptr_array_sized_new (g_hash_table_size (batch_requests));
+  g_hash_table_foreach (batch_requests, gtk_configure_batch_add_request, requests);
+  g_ptr_array_sort (requests, gtk_configure_request_compare);
+
+  /* The widget may have been unrealized since; the reference kept
+     the GdkWindow around, but it cannot be used anymore.  HACK!  GDK
+     has no public way to tell, but GdkWindowObject is public.  */
+  for (i = 0; i < requests->len; i++)
+    {
+      request = g_ptr_array_index (requests, i);
+      if (!((GdkWindowObject *) request->window)->destroyed)
+	gtk_configure_batch_apply (request->window, &request->geometry);
+    }
+
+  g_ptr_array_free (requests, TRUE);
+  g_hash_table_remove_all (batch_requests);
+}
+
+/* Batches can nest; the windows are configured when the outermost
+   one ends.  */
+void
+_gtk_configure_batch_begin (void)
+{
+  batch_depth++;
+}
+
+void
+_gtk_configure_batch_end (void)
+{
+  g_return_if_fail (batch_depth > 0);
+
+  if (--batch_depth == 0)
+    gtk_configure_batch_flush ();
+}
+
+/* Like gdk_window_move_resize, but nothing happens if the window is
+   already there, and inside a batch the window is only configured
+   when the batch ends.  */
+void
+_gtk_configure_batch_move_resize (GdkWindow *window,
+				  gint       x,
+				  gint       y,
+				  gint       width,
+				  gint       height)
+{
+  GtkConfigureRequest *request;
+  GdkRectangle geometry;
+
+  g_return_if_fail (GDK_IS_WINDOW (window));
+
+  stats_calls++;
+  geometry.x = x;
+  geometry.y = y;
+  geometry.width = width;
+  geometry.height = height;
+
+  if (batch_depth == 0)
+    {
+      gtk_configure_batch_apply (window, &geometry);
+      return;
+    }
+
+  if (!batch_requests)
+    batch_requests = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+					    NULL, gtk_configure_request_free);
+
+  request = g_hash_table_lookup (batch_requests, window);
+  if (!request)
+    {
+      request = g_slice_new (GtkConfigureRequest);
+      request->window = g_object_ref (window);
+      request->serial = batch_serial++;
+      g_hash_table_insert (batch_requests, window, request);
+    }
+
+  request->geometry = geometry;
+}
@@ -0,0 +1,43 @@
+/* GTK - The GIMP Toolkit
+ * Copyright (C) 2008 Free Software Foundation, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GTK_CONFIGURE_BATCH_H__
+#define __GTK_CONFIGURE_BATCH_H__
+
+#include <glib.h>
+#include <gdk/gdk.h>
+
+G_BEGIN_DECLS
+
+void      gtk_configure_batch_get_stats     (guint                      *n_calls,
+					     guint                      *n_requests);
+void      gtk_configure_batch_reset_stats   (void);
+
+/* Private.  */
+void      _gtk_configure_batch_begin        (void);
+void      _gtk_configure_batch_end          (void);
+void      _gtk_configure_batch_move_resize  (GdkWindow                  *window,
+					     gint                        x,
+					     gint                        y,
+					     gint                        width,
+					     gint                        height);
+
+G_END_DECLS
+
+#endif /* __GTK_CONFIGURE_BATCH_H__ */
@@ -24,6 +24,9 @@
 #include <string.h>
 #include <assert.h>
 #include "gtkellipsis.h"
+#include "gtklayoutstats.h"
+#include "gtkmeasurecache.h"
+#include "gtkconfigurebatch.h"
 
 #define GTK_ELLIPSIS_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), GTK_TYPE_ELLIPSIS, GtkEllipsisPrivate))
 
@@ -348,16 +351,15 @@ gtk_ellipsis_get_property (GObject    *object,
 static gint
 get_label_line_height (GtkWidget *label)
 {
+  GtkMeasurement measurement;
   PangoLayout *layout;
-  PangoLayoutIter *iter;
-  PangoRectangle rect;
 
   layout = gtk_label_get_layout (GTK_LABEL (label));
-  iter = pango_layout_get_iter (layout);
-  pango_layout_iter_get_line_extents (iter, NULL, &rect);
-  pango_layout_iter_free (iter);
+  if (!_gtk_measure_cache_lookup (layout, label->style->font_desc,
+				  pango_layout_get_width (layout), &measurement))
+    _gtk_measure_cache_measure (layout, label->style->font_desc, &measurement);
 
-  return (rect.y + rect.height) / PANGO_SCALE;
+  return measurement.first_line_bottom / PANGO_SCALE;
 }
 
 static void
@@ -599,11 +601,11 @@ gtk_ellipsis_size_allocate (GtkWidget     *widget,
       gtk_widget_size_allocate (priv->label, &label_allocation);
 
       if (GTK_WIDGET_REALIZED (widget))
-        gdk_window_move_resize (priv->event_window,
-			        allocation->x + border_width, 
-			        allocation->y + border_width, 
-			        MAX (allocation->width - 2 * border_width, 1), 
-			        MAX (label_allocation.height, 1));
+        _gtk_configure_batch_move_resize (priv->event_window,
+					  allocation->x + border_width,
+					  allocation->y + border_width,
+					  MAX (allocation->width - 2 * border_width, 1),
+					  MAX (label_allocation.height, 1));
     }
 
   if (priv->expanded)
@@ -1226,6 +1228,10 @@ gtk_ellipsis_set_expanded (GtkEllipsis *ellipsis,
   if (priv->expanded != expanded)
     {
       GtkWidget *child = GTK_BIN (ellipsis)->child;
+      gdouble start;
+
+      start = _gtk_layout_stats_begin (GTK_WIDGET (ellipsis),
+				       GTK_LAYOUT_STATS_ELLIPSIS_EXPAND);
       priv->expanded = expanded;
 
       if (child)
@@ -1254,9 +1260,12 @@ gtk_ellipsis_set_expanded (GtkEllipsis *ellipsis,
 	    }
 
 	  gtk_widget_queue_resize (GTK_WIDGET (ellipsis));
+	  _gtk_layout_stats_flow_start (GTK_LAYOUT_STATS_ELLIPSIS_EXPAND);
 	}
 
       g_object_notify (G_OBJECT (ellipsis), "expanded");
+      _gtk_layout_stats_end (GTK_WIDGET (ellipsis),
+			     GTK_LAYOUT_STATS_ELLIPSIS_EXPAND, start);
     }
 }
 
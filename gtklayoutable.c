@@ -18,12 +18,210 @@
  */
 
 
+#include <string.h>
 #include <gtk/gtk.h>
 #include "gtklayoutable.h"
+#include "gtklayoutstats.h"
+#include "gtkmeasurecache.h"
 
 #define I_(x)		(x)
 #define P_(x)		(x)
 
+/* HACK!  GTK+ does not export this flag.  gtk_widget_queue_resize sets
+   it on the widget and on all of its ancestors, and GTK+ clears it in
+   gtk_widget_size_allocate, but only if the widget's requisition is
+   up-to-date, which is never the case for wrapped labels.  */
+#define PRIVATE_GTK_ALLOC_NEEDED	(1 << 12)
+
+#define GTK_LAYOUTABLE_ALLOC_NEEDED(obj)	\
+  ((GTK_WIDGET (obj)->private_flags & PRIVATE_GTK_ALLOC_NEEDED) != 0)
+#define GTK_LAYOUTABLE_UNSET_ALLOC_NEEDED(obj)	\
+  (GTK_WIDGET (obj)->private_flags &= ~PRIVATE_GTK_ALLOC_NEEDED)
+
+typedef struct _GtkLayoutableData GtkLayoutableData;
+typedef struct _GtkLayoutableChild GtkLayoutableChild;
+typedef struct _GtkLayoutableIndex GtkLayoutableIndex;
+typedef struct _GtkLayoutableText GtkLayoutableText;
+
+/* A visible child of a box, together with its interface and its data,
+   so that laying it out does not need to look them up again.  */
+struct _GtkLayoutableChild
+{
+  GtkBoxChild *info;
+  GtkLayoutable *layoutable;
+  GtkLayoutableIface *iface;
+  GtkLayoutableData *data;
+};
+
+/* The space that each visible child of a vertical box takes, and a
+   Fenwick tree over it, so that the position of a child and the child
+   at a position can be found in O(log n).  The children are those of
+   the box's GtkLayoutableData, at the time children_serial was taken.  */
+struct _GtkLayoutableIndex
+{
+  gint n_children;
+  GtkLayoutableChild *children;
+  guint children_serial;
+  gint *sizes;
+  gint *tree;
+
+  /* The parameters that the sizes were computed for.  */
+  gint width;
+  gint spacing;
+
+  /* The children that were allocated by the last passes.  Unknown
+     until the first pass after the index was built.  */
+  gint first_allocated;
+  gint last_allocated;
+  guint allocated_known : 1;
+};
+
+/* The width of each character of a wrapped label and the places where
+   lines can be broken, taken from a layout that Pango already shaped.
+   The lines can then be broken again at another width without shaping
+   the text again.  */
+struct _GtkLayoutableText
+{
+  /* The counters of the label when the text was measured.  */
+  guint style_generation;
+  guint text_revision;
+
+  gint n_chars;
+  gint *advances;
+  guint8 *flags;
+
+  /* The height of the layout, and its number of lines.  */
+  gint height;
+  gint n_lines;
+
+  /* Set if Pango did not break the lines like we did.  */
+  guint inexact : 1;
+};
+
+#define TEXT_CAN_BREAK	(1 << 0)	/* a line can start here */
+#define TEXT_WHITE	(1 << 1)
+#define TEXT_PARAGRAPH	(1 << 2)	/* a line always ends here */
+
+struct _GtkLayoutableData
+{
+  /* Bumped by ::style-set and ::direction-changed.  */
+  guint style_generation;
+
+  /* Bumped by ::notify, i.e. whenever the text, the attributes
+     or the padding of a label change.  */
+  guint text_revision;
+
+  /* Height-for-width cache.  The key is a range of widths in Pango
+     units, over which the lines of a label are broken at the same
+     places, and the value of the two counters above at the time of the
+     measurement.  */
+  gint cache_min_width;
+  gint cache_max_width;
+  guint cache_style_generation;
+  guint cache_text_revision;
+  GtkRequisition cache_result;
+  guint cache_valid : 1;
+
+  /* Result of the last call to gtk_layoutable_size_allocate, and the
+     width it was called with.  As long as GTK+'s ALLOC_NEEDED flag is
+     clear and the width does not change, the allocation can be reused
+     and at most the widget needs to be moved.  */
+  guint allocated : 1;
+  gint allocated_width;
+  GtkAllocation allocation;
+
+  /* Set if the size in the allocation above is still valid for
+     allocated_width.  Unlike allocated, it stays set when the widget is
+     culled, so that the height can be used to skip the widget.  */
+  guint measured : 1;
+
+  /* Set if the height in the allocation above is only an estimate,
+     computed by gtk_layoutable_estimate_height for allocated_width.  */
+  guint estimated : 1;
+
+  /* Set if some widget in the subtree was culled (respectively, if some
+     widget in the subtree could be culled) the last time it was
+     allocated.  */
+  guint culled : 1;
+  guint can_cull : 1;
+
+  /* Set if a resize was queued on the widget since it was last
+     allocated, even if the ALLOC_NEEDED flag was cleared since.  */
+  guint resize_queued : 1;
+
+  /* Only for boxes: the visible children in layout order, that is
+     the GTK_PACK_START children followed by the GTK_PACK_END children
+     in reverse order.  GTK+ queues a resize on the box whenever a child
+     is added, removed, shown, hidden or repacked, so the list is only
+     walked again when the box had a resize queued.  children_serial is
+     bumped whenever the array changes.  */
+  GtkLayoutableChild *children;
+  gint n_children;
+  guint children_serial;
+  guint children_valid : 1;
+  guint remove_connected : 1;
+
+  /* Only for vertical boxes.  */
+  GtkLayoutableIndex *index;
+
+  /* Only for wrapped labels that were laid out at more than one width.
+     If width_pending is set, the label was reflowed at pending_width
+     with the data in text, and the PangoLayout of the label has not
+     been told yet.  */
+  GtkLayoutableText *text;
+  gint pending_width;
+  guint width_pending : 1;
+  guint expose_connected : 1;
+};
+
+static GQuark		quark_layoutable_data;
+
+/* The area passed to gtk_layoutable_size_allocate_visible, and the
+   state of the subtree that is being allocated.  */
+static const GdkRectangle *visible_area;
+static gboolean		layout_culled;
+static gboolean		layout_can_cull;
+
+/* Set by gtk_layoutable_size_allocate_more.  */
+static gboolean		layout_keep_allocated;
+
+/* The y coordinate passed to gtk_layoutable_size_allocate_visible, and
+   how much the content above it grew or shrank in the current pass.  */
+static gboolean		layout_anchored;
+static gint		layout_anchor;
+static gint		layout_anchor_delta;
+
+/* The region passed to gtk_layoutable_track_damage.  */
+static GdkRegion	*layout_damage;
+
+/* Font metrics used to estimate the height of wrapped labels.  */
+static PangoFontDescription *estimate_font;
+static gint		estimate_char_width;
+static gint		estimate_line_height;
+
+static GtkLayoutableData *gtk_layoutable_get_data (GtkLayoutable *layoutable);
+static void		gtk_layoutable_child_init (GtkLayoutableChild *child,
+						   GtkLayoutable      *layoutable);
+static void		gtk_layoutable_child_size_allocate (const GtkLayoutableChild *child,
+							    GtkAllocation            *allocation);
+static gint		gtk_layoutable_child_estimate_height (const GtkLayoutableChild *child,
+							      gint                      width);
+static void		gtk_layoutable_child_move (const GtkLayoutableChild *child,
+						   gint                      dx,
+						   gint                      dy);
+static gint		gtk_layoutable_index_sum (GtkLayoutableIndex *index,
+						  gint                nth);
+static gint		gtk_layoutable_index_find (GtkLayoutableIndex *index,
+						   gint                y);
+static void		gtk_layoutable_store_estimate (GtkWidget         *widget,
+						       GtkLayoutableData *data,
+						       gint               width,
+						       gint               height);
+static void		gtk_layoutable_allocate_child (const GtkLayoutableChild *child,
+						       GtkAllocation            *allocation);
+static void		gtk_layoutable_add_damage (GtkWidget           *widget,
+						   const GtkAllocation *old_allocation);
+
 static void		gtk_widget_add_layoutable_interface ();
 static void		gtk_label_add_layoutable_interface ();
 static void		gtk_hbox_add_layoutable_interface ();
@@ -53,6 +251,7 @@ gtk_layoutable_init (void)
     return;
 
   once_only = 1;
+  quark_layoutable_data = g_quark_from_static_string (I_("gtk-layoutable-data"));
   gtk_widget_add_layoutable_interface ();
   gtk_label_add_layoutable_interface ();
   gtk_hbox_add_layoutable_interface ();
@@ -69,33 +268,757 @@ gtk_layoutable_size_request (GtkLayoutable        *layoutable,
                              GtkRequisition       *requisition)
 {
   GtkLayoutableIface *iface;
+  gdouble start;
 
   g_return_if_fail (GTK_IS_LAYOUTABLE (layoutable));
   g_return_if_fail (requisition != NULL);
 
+  start = _gtk_layout_stats_begin (GTK_WIDGET (layoutable),
+				   GTK_LAYOUT_STATS_REQUEST);
   iface = GTK_LAYOUTABLE_GET_IFACE (layoutable);
   if (iface->size_request)
     (* iface->size_request) (layoutable, requisition);
+  _gtk_layout_stats_end (GTK_WIDGET (layoutable), GTK_LAYOUT_STATS_REQUEST, start);
 }
 
+/**
+ * gtk_layoutable_size_allocate:
+ * @layoutable: a #GtkLayoutable
+ * @allocation: a #GtkAllocation
+ *
+ * Lays out @layoutable at the width and position given by @allocation,
+ * and stores the actual size of the widget back into @allocation.
+ * If nothing in the subtree queued a resize since the last call and
+ * the width is the same, the widget is just moved.
+ **/
 void
 gtk_layoutable_size_allocate (GtkLayoutable        *layoutable,
                               GtkAllocation        *allocation)
 {
-  GtkLayoutableIface *iface;
+  GtkLayoutableChild child;
 
   g_return_if_fail (GTK_IS_LAYOUTABLE (layoutable));
   g_return_if_fail (allocation != NULL);
   g_return_if_fail (allocation->height == 0);
 
-  iface = GTK_LAYOUTABLE_GET_IFACE (layoutable);
+  gtk_layoutable_child_init (&child, layoutable);
+  gtk_layoutable_child_size_allocate (&child, allocation);
+}
+
+/* The boxes call this directly for their children, with the interface
+   and data that they looked up when the children were last added.  */
+static void
+gtk_layoutable_child_size_allocate (const GtkLayoutableChild *child,
+                                    GtkAllocation            *allocation)
+{
+  GtkLayoutable *layoutable = child->layoutable;
+  GtkLayoutableIface *iface = child->iface;
+  GtkLayoutableData *data = child->data;
+  GtkWidget *widget;
+  gboolean outer_culled, outer_can_cull;
+  gdouble start;
+  gint width;
+
+  widget = GTK_WIDGET (layoutable);
+  start = _gtk_layout_stats_begin (widget, GTK_LAYOUT_STATS_ALLOCATE);
+
+  /* If somebody else allocated the widget in the meanwhile, the
+     size will usually be different and we cannot trust the data.
+     Subtrees that were culled, or that are only partly visible and
+     could be culled, also have to be walked again.  */
+  if (data->allocated
+      && data->allocated_width == allocation->width
+      && data->allocation.width == widget->allocation.width
+      && data->allocation.height == widget->allocation.height
+      && !GTK_LAYOUTABLE_ALLOC_NEEDED (widget)
+      && !data->culled
+      && !(visible_area && data->can_cull
+	   && (allocation->y < visible_area->y
+	       || (allocation->y + data->allocation.height
+		   > visible_area->y + visible_area->height))))
+    {
+      gtk_layoutable_child_move (child,
+				 allocation->x - widget->allocation.x,
+				 allocation->y - widget->allocation.y);
+      *allocation = widget->allocation;
+      layout_can_cull |= data->can_cull;
+      _gtk_layout_stats_end (widget, GTK_LAYOUT_STATS_ALLOCATE, start);
+      return;
+    }
+
+  outer_culled = layout_culled;
+  outer_can_cull = layout_can_cull;
+  layout_culled = layout_can_cull = FALSE;
+
+  width = allocation->width;
   if (iface->size_allocate)
     (* iface->size_allocate) (layoutable, allocation);
+
+  data->allocated = TRUE;
+  data->measured = TRUE;
+  data->estimated = FALSE;
+  data->allocated_width = width;
+  data->allocation = *allocation;
+  data->culled = layout_culled;
+  data->can_cull = layout_can_cull;
+  data->resize_queued = FALSE;
+
+  layout_culled |= outer_culled;
+  layout_can_cull |= outer_can_cull;
+
+  /* GTK+ only clears the flag if the requisition is up-to-date, which
+     is never the case for wrapped labels and layoutable boxes.  */
+  GTK_LAYOUTABLE_UNSET_ALLOC_NEEDED (widget);
+  _gtk_layout_stats_end (widget, GTK_LAYOUT_STATS_ALLOCATE, start);
+}
+
+/**
+ * gtk_layoutable_size_allocate_visible:
+ * @layoutable: a #GtkLayoutable
+ * @allocation: a #GtkAllocation
+ * @visible: the visible part of the allocation, or %NULL
+ * @anchor: a y coordinate, or %NULL
+ *
+ * Like gtk_layoutable_size_allocate, but children of vertical boxes that
+ * are outside @visible are not allocated.  They are hidden with
+ * gtk_widget_set_child_visible and unrealized instead; if their height
+ * is not known, it is estimated with gtk_layoutable_estimate_height.
+ *
+ * If @anchor is not %NULL, it is updated so that it points to the same
+ * content after the heights of the children above it were corrected.
+ **/
+void
+gtk_layoutable_size_allocate_visible (GtkLayoutable        *layoutable,
+                                      GtkAllocation        *allocation,
+                                      const GdkRectangle   *visible,
+                                      gint                 *anchor)
+{
+  const GdkRectangle *old_visible_area;
+  gboolean old_anchored;
+  gint old_anchor, old_anchor_delta;
+
+  old_visible_area = visible_area;
+  old_anchored = layout_anchored;
+  old_anchor = layout_anchor;
+  old_anchor_delta = layout_anchor_delta;
+
+  visible_area = visible;
+  layout_anchored = (anchor != NULL);
+  layout_anchor = anchor ? *anchor : 0;
+  layout_anchor_delta = 0;
+
+  gtk_layoutable_size_allocate (layoutable, allocation);
+  if (anchor)
+    *anchor += layout_anchor_delta;
+
+  visible_area = old_visible_area;
+  layout_anchored = old_anchored;
+  layout_anchor = old_anchor;
+  layout_anchor_delta = old_anchor_delta;
+}
+
+/**
+ * gtk_layoutable_size_allocate_more:
+ * @layoutable: a #GtkLayoutable
+ * @allocation: a #GtkAllocation
+ * @area: the part of the allocation to lay out
+ * @anchor: a y coordinate, or %NULL
+ *
+ * Like gtk_layoutable_size_allocate_visible, but the children of
+ * vertical boxes that earlier calls allocated stay allocated, even
+ * if they are outside @area.  This lays out a large tree in steps,
+ * by passing areas next to each other.  If @area is not next to the
+ * children that are already allocated, they are culled as usual.
+ **/
+void
+gtk_layoutable_size_allocate_more (GtkLayoutable        *layoutable,
+                                   GtkAllocation        *allocation,
+                                   const GdkRectangle   *area,
+                                   gint                 *anchor)
+{
+  gboolean old_keep_allocated;
+
+  g_return_if_fail (area != NULL);
+
+  old_keep_allocated = layout_keep_allocated;
+  layout_keep_allocated = TRUE;
+  gtk_layoutable_size_allocate_visible (layoutable, allocation, area, anchor);
+  layout_keep_allocated = old_keep_allocated;
+}
+
+/**
+ * gtk_layoutable_track_damage:
+ * @damage: a #GdkRegion, or %NULL
+ *
+ * Until this function is called again with %NULL, the old and new
+ * areas of the widgets that are allocated again or moved are added
+ * to @damage.  Widgets that are only moved with their boxes are not
+ * tracked one by one.
+ **/
+void
+gtk_layoutable_track_damage (GdkRegion            *damage)
+{
+  layout_damage = damage;
+}
+
+/**
+ * gtk_layoutable_estimate_height:
+ * @layoutable: a #GtkLayoutable
+ * @width: the width to estimate the height for
+ *
+ * Returns a cheap guess of the height that @layoutable would have if it
+ * was allocated @width pixels.  If the widget was already allocated at
+ * that width, the actual height is returned.
+ *
+ * Return value: the estimated height
+ **/
+gint
+gtk_layoutable_estimate_height (GtkLayoutable        *layoutable,
+                                gint                  width)
+{
+  GtkLayoutableChild child;
+
+  g_return_val_if_fail (GTK_IS_LAYOUTABLE (layoutable), 0);
+
+  gtk_layoutable_child_init (&child, layoutable);
+  return gtk_layoutable_child_estimate_height (&child, width);
+}
+
+static gint
+gtk_layoutable_child_estimate_height (const GtkLayoutableChild *child,
+                                      gint                      width)
+{
+  GtkLayoutableData *data = child->data;
+  GtkWidget *widget;
+
+  widget = GTK_WIDGET (child->layoutable);
+  if ((data->measured || data->estimated)
+      && data->allocated_width == width
+      && !GTK_LAYOUTABLE_ALLOC_NEEDED (widget))
+    return data->allocation.height;
+
+  gtk_layoutable_store_estimate (widget, data, width,
+				 child->iface->estimate_height
+				 ? (* child->iface->estimate_height) (child->layoutable, width)
+				 : 0);
+
+  return data->allocation.height;
+}
+
+/**
+ * gtk_layoutable_set_estimated_height:
+ * @layoutable: a #GtkLayoutable
+ * @width: a width
+ * @height: the height of @layoutable at @width
+ *
+ * Makes gtk_layoutable_estimate_height return @height for @width, for
+ * example because the height was computed in another thread.  Nothing
+ * happens if the widget was already laid out at @width.
+ **/
+void
+gtk_layoutable_set_estimated_height (GtkLayoutable        *layoutable,
+                                     gint                  width,
+                                     gint                  height)
+{
+  GtkLayoutableData *data;
+  GtkWidget *widget;
+
+  g_return_if_fail (GTK_IS_LAYOUTABLE (layoutable));
+
+  widget = GTK_WIDGET (layoutable);
+  data = gtk_layoutable_get_data (layoutable);
+  if (data->measured
+      && data->allocated_width == width
+      && !GTK_LAYOUTABLE_ALLOC_NEEDED (widget))
+    return;
+
+  gtk_layoutable_store_estimate (widget, data, width, height);
+}
+
+/**
+ * gtk_layoutable_is_allocated:
+ * @layoutable: a #GtkLayoutable
+ * @width: a width
+ *
+ * Tells whether @layoutable was laid out at @width and nothing in it
+ * queued a resize since.  If so, allocating it again at @width would
+ * at most move it, unless parts of it were culled.
+ *
+ * Return value: %TRUE if the last allocation is still valid for @width
+ **/
+gboolean
+gtk_layoutable_is_allocated (GtkLayoutable        *layoutable,
+                             gint                  width)
+{
+  GtkLayoutableData *data;
+
+  g_return_val_if_fail (GTK_IS_LAYOUTABLE (layoutable), FALSE);
+
+  data = g_object_get_qdata (G_OBJECT (layoutable), quark_layoutable_data);
+  return (data
+	  && data->allocated
+	  && data->allocated_width == width
+	  && !data->resize_queued
+	  && !GTK_LAYOUTABLE_ALLOC_NEEDED (layoutable));
+}
+
+static void
+gtk_layoutable_store_estimate (GtkWidget         *widget,
+                               GtkLayoutableData *data,
+                               gint               width,
+                               gint               height)
+{
+  data->allocation.width = width;
+  data->allocation.height = height;
+
+  /* A queued resize is taken care of by the estimate, but the widget
+     has to be laid out before the allocation can be reused.  */
+  if (GTK_LAYOUTABLE_ALLOC_NEEDED (widget))
+    {
+      data->cache_valid = FALSE;
+      data->resize_queued = TRUE;
+    }
+
+  data->allocated = FALSE;
+  data->measured = FALSE;
+  data->estimated = TRUE;
+  data->allocated_width = width;
+  GTK_LAYOUTABLE_UNSET_ALLOC_NEEDED (widget);
+}
+
+static GtkLayoutableIndex *
+gtk_layoutable_get_index (GtkLayoutable *layoutable)
+{
+  GtkLayoutableData *data;
+
+  /* The index may refer to children that were removed, until the
+     box is allocated again.  */
+  data = g_object_get_qdata (G_OBJECT (layoutable), quark_layoutable_data);
+  if (!data
+      || !data->index
+      || !data->children_valid
+      || !data->allocated
+      || data->resize_queued
+      || GTK_LAYOUTABLE_ALLOC_NEEDED (layoutable)
+      || GTK_BOX (layoutable)->homogeneous)
+    return NULL;
+
+  return data->index;
+}
+
+/**
+ * gtk_layoutable_get_child_at_y:
+ * @layoutable: a #GtkLayoutable
+ * @y: a y coordinate, in the same coordinates as the allocation
+ * @nth: return location for the position of the child, or %NULL
+ *
+ * Finds the child of a vertical box that covers @y, or the closest
+ * one.  The position of the child counts only the visible children,
+ * in the order in which they are laid out.  This takes O(log n) time.
+ *
+ * Return value: the child, or %NULL if @layoutable is not a vertical
+ * box or it was not allocated since its children changed.
+ **/
+GtkWidget *
+gtk_layoutable_get_child_at_y (GtkLayoutable        *layoutable,
+                               gint                  y,
+                               gint                 *nth)
+{
+  GtkLayoutableIndex *index;
+  gint i;
+
+  g_return_val_if_fail (GTK_IS_LAYOUTABLE (layoutable), NULL);
+
+  if (!GTK_IS_VBOX (layoutable))
+    return NULL;
+
+  index = gtk_layoutable_get_index (layoutable);
+  if (!index || index->n_children == 0)
+    return NULL;
+
+  i = gtk_layoutable_index_find (index, y - GTK_WIDGET (layoutable)->allocation.y -
+				 GTK_CONTAINER (layoutable)->border_width);
+  i = MIN (i, index->n_children - 1);
+  if (nth)
+    *nth = i;
+
+  return index->children[i].info->widget;
+}
+
+/**
+ * gtk_layoutable_get_child_y:
+ * @layoutable: a #GtkLayoutable
+ * @nth: the position of a child, as returned by gtk_layoutable_get_child_at_y
+ * @y: return location for the y coordinate of the child
+ *
+ * Finds where the @nth visible child of a vertical box is, even if it
+ * was culled.  This takes O(log n) time.
+ *
+ * Return value: %TRUE if @y was set
+ **/
+gboolean
+gtk_layoutable_get_child_y (GtkLayoutable        *layoutable,
+                            gint                  nth,
+                            gint                 *y)
+{
+  GtkLayoutableIndex *index;
+
+  g_return_val_if_fail (GTK_IS_LAYOUTABLE (layoutable), FALSE);
+  g_return_val_if_fail (y != NULL, FALSE);
+
+  if (!GTK_IS_VBOX (layoutable))
+    return FALSE;
+
+  index = gtk_layoutable_get_index (layoutable);
+  if (!index || nth < 0 || nth >= index->n_children)
+    return FALSE;
+
+  *y = GTK_WIDGET (layoutable)->allocation.y
+       + GTK_CONTAINER (layoutable)->border_width
+       + gtk_layoutable_index_sum (index, nth)
+       + index->children[nth].info->padding;
+  return TRUE;
+}
+
+/**
+ * gtk_layoutable_propagate_expose:
+ * @container: a #GtkContainer
+ * @child: a child of @container
+ * @event: an expose event sent to @container
+ *
+ * Like gtk_container_propagate_expose, but if @child is a layoutable box,
+ * the event is sent directly to those of its children that intersect
+ * the exposed area.  For vertical boxes, they are found in O(log n)
+ * time, so that the cost of an expose depends on the size of the area
+ * and not on the number of children.
+ **/
+void
+gtk_layoutable_propagate_expose (GtkContainer         *container,
+                                 GtkWidget            *child,
+                                 GdkEventExpose       *event)
+{
+  GtkLayoutableIndex *index;
+  GdkRectangle rect;
+  GList *list;
+  gdouble start;
+  gint i, y;
+
+  g_return_if_fail (GTK_IS_CONTAINER (container));
+  g_return_if_fail (GTK_IS_WIDGET (child));
+  g_return_if_fail (event != NULL);
+
+  start = _gtk_layout_stats_begin (child, GTK_LAYOUT_STATS_EXPOSE);
+
+  /* Subclasses could draw something, or have their own expose_event;
+     and like gtk_container_propagate_expose, leave widgets with their
+     own window to GDK.  */
+  if ((G_OBJECT_TYPE (child) != GTK_TYPE_VBOX
+       && G_OBJECT_TYPE (child) != GTK_TYPE_HBOX)
+      || !GTK_WIDGET_NO_WINDOW (child)
+      || child->window != event->window)
+    {
+      gtk_container_propagate_expose (container, child, event);
+      _gtk_layout_stats_end (child, GTK_LAYOUT_STATS_EXPOSE, start);
+      return;
+    }
+
+  if (!GTK_WIDGET_DRAWABLE (child)
+      || !gdk_rectangle_intersect (&event->area, &child->allocation, &rect))
+    {
+      _gtk_layout_stats_end (child, GTK_LAYOUT_STATS_EXPOSE, start);
+      return;
+    }
+
+  index = NULL;
+  if (GTK_IS_VBOX (child))
+    index = gtk_layoutable_get_index (GTK_LAYOUTABLE (child));
+
+  if (index)
+    {
+      y = child->allocation.y + GTK_CONTAINER (child)->border_width;
+      i = gtk_layoutable_index_find (index, event->area.y - y);
+      y += gtk_layoutable_index_sum (index, i);
+      for (; i < index->n_children && y < event->area.y + event->area.height; i++)
+	{
+	  gtk_layoutable_propagate_expose (GTK_CONTAINER (child),
+					   index->children[i].info->widget, event);
+	  y += index->sizes[i];
+	}
+    }
+  else
+    {
+      /* Rows of a horizontal box are short, just check each child.  */
+      for (list = GTK_BOX (child)->children; list; list = list->next)
+	{
+	  GtkBoxChild *child_info = list->data;
+	  GtkWidget *widget = child_info->widget;
+	  if (GTK_WIDGET_DRAWABLE (widget)
+	      && (!GTK_WIDGET_NO_WINDOW (widget)
+		  || gdk_rectangle_intersect (&event->area, &widget->allocation, &rect)))
+	    gtk_layoutable_propagate_expose (GTK_CONTAINER (child), widget, event);
+	}
+    }
+
+  _gtk_layout_stats_end (child, GTK_LAYOUT_STATS_EXPOSE, start);
+}
+
+/**
+ * gtk_layoutable_move:
+ * @layoutable: a #GtkLayoutable
+ * @dx: horizontal offset
+ * @dy: vertical offset
+ *
+ * Moves @layoutable and all its children by the given offset, without
+ * laying them out again.
+ **/
+void
+gtk_layoutable_move (GtkLayoutable        *layoutable,
+		     gint                  dx,
+		     gint                  dy)
+{
+  GtkLayoutableChild child;
+
+  g_return_if_fail (GTK_IS_LAYOUTABLE (layoutable));
+
+  gtk_layoutable_child_init (&child, layoutable);
+  gtk_layoutable_child_move (&child, dx, dy);
+}
+
+static void
+gtk_layoutable_child_move (const GtkLayoutableChild *child,
+                           gint                      dx,
+                           gint                      dy)
+{
+  if (dx == 0 && dy == 0)
+    return;
+
+  if (child->iface->move)
+    (* child->iface->move) (child->layoutable, dx, dy);
+
+  child->data->allocation.x += dx;
+  child->data->allocation.y += dy;
+}
+
+
+static void
+gtk_layoutable_style_set (GtkWidget         *widget,
+                          GtkStyle          *previous_style,
+                          GtkLayoutableData *data)
+{
+  data->style_generation++;
+}
+
+static void
+gtk_layoutable_direction_changed (GtkWidget         *widget,
+                                  GtkTextDirection   previous_direction,
+                                  GtkLayoutableData *data)
+{
+  data->style_generation++;
+}
+
+static void
+gtk_layoutable_notify (GObject           *object,
+                       GParamSpec        *pspec,
+                       GtkLayoutableData *data)
+{
+  data->text_revision++;
+}
+
+static void
+gtk_layoutable_index_free (GtkLayoutableIndex *index)
+{
+  g_free (index->sizes);
+  g_free (index->tree);
+  g_free (index);
+}
+
+static void
+gtk_layoutable_text_free (GtkLayoutableText *text)
+{
+  g_free (text->advances);
+  g_free (text->flags);
+  g_free (text);
+}
+
+static void
+gtk_layoutable_data_free (gpointer p)
+{
+  GtkLayoutableData *data = p;
+
+  if (data->index)
+    gtk_layoutable_index_free (data->index);
+  g_free (data->children);
+  if (data->text)
+    gtk_layoutable_text_free (data->text);
+  g_free (data);
+}
+
+static GtkLayoutableData *
+gtk_layoutable_get_data (GtkLayoutable *layoutable)
+{
+  GtkLayoutableData *data;
+
+  data = g_object_get_qdata (G_OBJECT (layoutable), quark_layoutable_data);
+  if (G_UNLIKELY (!data))
+    {
+      data = g_new0 (GtkLayoutableData, 1);
+      g_object_set_qdata_full (G_OBJECT (layoutable), quark_layoutable_data,
+			       data, gtk_layoutable_data_free);
+
+      /* The data is freed together with the object, and so are
+	 the signal handlers.  */
+      g_signal_connect (layoutable, "style-set",
+			G_CALLBACK (gtk_layoutable_style_set), data);
+      g_signal_connect (layoutable, "direction-changed",
+			G_CALLBACK (gtk_layoutable_direction_changed), data);
+      g_signal_connect (layoutable, "notify",
+			G_CALLBACK (gtk_layoutable_notify), data);
+    }
+
+  return data;
+}
+
+static void
+gtk_layoutable_child_init (GtkLayoutableChild *child,
+                           GtkLayoutable      *layoutable)
+{
+  child->info = NULL;
+  child->layoutable = layoutable;
+  child->iface = GTK_LAYOUTABLE_GET_IFACE (layoutable);
+  child->data = gtk_layoutable_get_data (layoutable);
+}
+
+static void
+gtk_layoutable_release (GtkWidget *widget,
+                        gpointer   unused)
+{
+  GtkLayoutableData *data;
+
+  data = g_object_get_qdata (G_OBJECT (widget), quark_layoutable_data);
+  if (data)
+    {
+      data->allocated = FALSE;
+      data->cache_valid = FALSE;
+    }
+
+  /* HACK!  There is no API to do this, but GtkLabel creates the layout
+     again as soon as it is needed.  */
+  if (GTK_IS_LABEL (widget) && GTK_LABEL (widget)->layout)
+    {
+      g_object_unref (GTK_LABEL (widget)->layout);
+      GTK_LABEL (widget)->layout = NULL;
+    }
+
+  if (GTK_IS_CONTAINER (widget))
+    gtk_container_forall (GTK_CONTAINER (widget),
+			  gtk_layoutable_release, NULL);
+}
+
+static void
+gtk_layoutable_add_damage (GtkWidget           *widget,
+                           const GtkAllocation *old_allocation)
+{
+  if (!layout_damage)
+    return;
+
+  gdk_region_union_with_rect (layout_damage, old_allocation);
+  gdk_region_union_with_rect (layout_damage, &widget->allocation);
+}
+
+/* Like gtk_widget_size_allocate, but nothing happens if the widget
+   already has that allocation and did not queue a resize.  */
+static void
+gtk_layoutable_widget_size_allocate (GtkWidget     *widget,
+                                     GtkAllocation *allocation)
+{
+  GtkAllocation old_allocation;
+
+  old_allocation = widget->allocation;
+  if (!GTK_LAYOUTABLE_ALLOC_NEEDED (widget)
+      && allocation->x == old_allocation.x
+      && allocation->y == old_allocation.y
+      && allocation->width == old_allocation.width
+      && allocation->height == old_allocation.height)
+    return;
+
+  gtk_widget_size_allocate (widget, allocation);
+  gtk_layoutable_add_damage (widget, &old_allocation);
+}
+
+static void
+gtk_layoutable_cull (GtkWidget *widget,
+                     gboolean   release)
+{
+  if (gtk_widget_get_child_visible (widget))
+    {
+      gtk_widget_set_child_visible (widget, FALSE);
+      if (GTK_WIDGET_REALIZED (widget))
+	gtk_widget_unrealize (widget);
+      release = TRUE;
+    }
+
+  /* Only the height is needed while the widget is not visible; drop
+     everything else and lay it out again when it comes back.  */
+  if (release)
+    gtk_layoutable_release (widget, NULL);
+
+  layout_culled = TRUE;
+}
+
+/* Allocate a child of a vertical box.  Children outside the visible
+   area only need their height, and are culled; if the height is not
+   known yet, it is estimated.  */
+static void
+gtk_layoutable_allocate_child (const GtkLayoutableChild *child,
+                               GtkAllocation            *allocation)
+{
+  GtkLayoutableData *data = child->data;
+  GtkWidget *widget = GTK_WIDGET (child->layoutable);
+  gint y, height, old_height, old_anchor_delta;
+
+  y = allocation->y;
+  old_height = (data->measured || data->estimated) ? data->allocation.height : 0;
+  old_anchor_delta = layout_anchor_delta;
+
+  if (visible_area)
+    {
+      height = gtk_layoutable_child_estimate_height (child, allocation->width);
+      if (y + height <= visible_area->y
+	  || y >= visible_area->y + visible_area->height)
+	{
+	  allocation->height = height;
+	  gtk_layoutable_cull (widget, FALSE);
+	  goto out;
+	}
+    }
+
+  gtk_layoutable_child_size_allocate (child, allocation);
+
+  if (visible_area
+      && (y + allocation->height <= visible_area->y
+	  || y >= visible_area->y + visible_area->height))
+    gtk_layoutable_cull (widget, TRUE);
+  else if (!gtk_widget_get_child_visible (widget))
+    gtk_widget_set_child_visible (widget, TRUE);
+
+out:
+  /* If the child was entirely above the anchor before this pass, all
+     the change in its height is above the anchor.  Otherwise, only
+     the changes in its own children are, and those have already
+     been accounted for.  */
+  if (layout_anchored
+      && y - old_anchor_delta + old_height <= layout_anchor)
+    layout_anchor_delta = old_anchor_delta + allocation->height - old_height;
 }
 
 
 static void gtk_widget_layoutable_size_allocate (GtkLayoutable        *layoutable,
                                                  GtkAllocation        *allocation);
+static void gtk_widget_layoutable_move          (GtkLayoutable        *layoutable,
+                                                 gint                  dx,
+                                                 gint                  dy);
+static gint gtk_widget_layoutable_estimate_height (GtkLayoutable      *layoutable,
+                                                   gint                width);
 
 static GtkLayoutableIface    *gtk_widget_parent_layoutable_iface;
 
@@ -105,6 +1028,8 @@ gtk_widget_layoutable_init (GtkLayoutableIface *iface)
   gtk_widget_parent_layoutable_iface = g_type_interface_peek_parent (iface);
   iface->size_request = (void (*) (GtkLayoutable *, GtkRequisition *)) gtk_widget_size_request;
   iface->size_allocate = gtk_widget_layoutable_size_allocate;
+  iface->move = gtk_widget_layoutable_move;
+  iface->estimate_height = gtk_widget_layoutable_estimate_height;
 }
 
 static void
@@ -133,13 +1058,42 @@ gtk_widget_layoutable_size_allocate (GtkLayoutable        *layoutable,
   gtk_widget_get_child_requisition (widget, &requisition);
   allocation->width = requisition.width;
   allocation->height = requisition.height;
-  gtk_widget_size_allocate (widget, allocation);
+  gtk_layoutable_widget_size_allocate (widget, allocation);
+}
+
+static void
+gtk_widget_layoutable_move (GtkLayoutable        *layoutable,
+                            gint                  dx,
+                            gint                  dy)
+{
+  GtkWidget *widget;
+  GtkAllocation allocation, old_allocation;
+
+  widget = GTK_WIDGET (layoutable);
+  old_allocation = allocation = widget->allocation;
+  allocation.x += dx;
+  allocation.y += dy;
+  gtk_widget_size_allocate (widget, &allocation);
+  if (dx || dy)
+    gtk_layoutable_add_damage (widget, &old_allocation);
+}
+
+static gint
+gtk_widget_layoutable_estimate_height (GtkLayoutable        *layoutable,
+                                       gint                  width)
+{
+  GtkRequisition requisition;
+
+  gtk_widget_get_child_requisition (GTK_WIDGET (layoutable), &requisition);
+  return requisition.height;
 }
 
 static void gtk_label_layoutable_size_request (GtkLayoutable        *layoutable,
 		                               GtkRequisition       *requisition);
 static void gtk_label_layoutable_size_allocate (GtkLayoutable        *layoutable,
                                                 GtkAllocation        *allocation);
+static gint gtk_label_layoutable_estimate_height (GtkLayoutable      *layoutable,
+                                                  gint                width);
 
 static GtkLayoutableIface    *gtk_label_parent_layoutable_iface;
 
@@ -149,6 +1103,7 @@ gtk_label_layoutable_init (GtkLayoutableIface *iface)
   gtk_label_parent_layoutable_iface = g_type_interface_peek_parent (iface);
   iface->size_request = gtk_label_layoutable_size_request;
   iface->size_allocate = gtk_label_layoutable_size_allocate;
+  iface->estimate_height = gtk_label_layoutable_estimate_height;
 }
 
 static void
@@ -178,6 +1133,269 @@ gtk_label_layoutable_size_request (GtkLayoutable        *layoutable,
     gtk_widget_size_request (GTK_WIDGET (label), requisition);
 }
 
+static GtkLayoutableText *
+gtk_label_layoutable_text_new (GtkLabel             *label,
+                               GtkLayoutableData    *data,
+                               PangoLayout          *layout)
+{
+  GtkLayoutableText *text;
+  PangoLayoutIter *iter;
+  PangoLogAttr *attrs;
+  PangoRectangle rect;
+  const gchar *str, *p;
+  gint *offsets;
+  gint n_attrs, n_bytes, i;
+
+  str = pango_layout_get_text (layout);
+  n_bytes = strlen (str);
+
+  text = g_new (GtkLayoutableText, 1);
+  text->style_generation = data->style_generation;
+  text->text_revision = data->text_revision;
+  text->n_chars = g_utf8_strlen (str, n_bytes);
+  text->advances = g_new0 (gint, text->n_chars);
+  text->flags = g_new0 (guint8, text->n_chars);
+  text->inexact = FALSE;
+
+  /* Map byte indices to characters; the iterator below goes in visual
+     order.  */
+  offsets = g_new (gint, n_bytes + 1);
+  pango_layout_get_log_attrs (layout, &attrs, &n_attrs);
+  for (i = 0, p = str; i < text->n_chars; i++, p = g_utf8_next_char (p))
+    {
+      offsets[p - str] = i;
+      if (attrs[i].is_line_break)
+	text->flags[i] |= TEXT_CAN_BREAK;
+      if (attrs[i].is_white)
+	text->flags[i] |= TEXT_WHITE;
+      if (*p == '\n')
+	text->flags[i] |= TEXT_PARAGRAPH;
+    }
+  g_free (attrs);
+
+  iter = pango_layout_get_iter (layout);
+  do
+    {
+      i = pango_layout_iter_get_index (iter);
+      if (i < n_bytes)
+	{
+	  pango_layout_iter_get_char_extents (iter, &rect);
+	  text->advances[offsets[i]] = ABS (rect.width);
+	}
+    }
+  while (pango_layout_iter_next_char (iter));
+  pango_layout_iter_free (iter);
+  g_free (offsets);
+
+  pango_layout_get_extents (layout, NULL, &rect);
+  text->height = rect.height;
+  text->n_lines = MAX (pango_layout_get_line_count (layout), 1);
+
+  return text;
+}
+
+/* Break the lines greedily at WIDTH Pango units, like PANGO_WRAP_WORD;
+   a word that does not fit on a line by itself is broken anywhere.
+   White space at the end of a line can go past WIDTH.
+
+   The lines are broken at the same places for all the widths from
+   MIN_WIDTH (the widest line without its trailing white space) up to,
+   but excluding, MAX_WIDTH (the narrowest line plus the character that
+   did not fit on it).  */
+static void
+gtk_layoutable_text_reflow (GtkLayoutableText    *text,
+                            gint                  width,
+                            gint                 *text_width,
+                            gint                 *text_height,
+                            gint                 *min_width,
+                            gint                 *max_width)
+{
+  gint lines, line_width, ink_width, prev_ink_width, widest;
+  gint break_at, width_at_break, ink_at_break;
+  gint lower, upper;
+  gboolean overfull;
+  gint i;
+
+  lines = 1;
+  line_width = ink_width = prev_ink_width = widest = 0;
+  break_at = -1;
+  width_at_break = ink_at_break = 0;
+  lower = 0;
+  upper = G_MAXINT;
+  overfull = FALSE;
+  for (i = 0; i < text->n_chars; i++)
+    {
+      if (text->flags[i] & TEXT_PARAGRAPH)
+	{
+	  widest = MAX (widest, line_width);
+	  lower = MAX (lower, ink_width);
+	  line_width = ink_width = 0;
+	  break_at = -1;
+	  lines++;
+	  continue;
+	}
+
+      if ((text->flags[i] & TEXT_CAN_BREAK) && line_width > 0)
+	{
+	  break_at = i;
+	  width_at_break = line_width;
+	  ink_at_break = ink_width;
+	}
+
+      line_width += text->advances[i];
+      if (!(text->flags[i] & TEXT_WHITE))
+	{
+	  prev_ink_width = ink_width;
+	  ink_width = line_width;
+	}
+
+      if (line_width <= width || (text->flags[i] & TEXT_WHITE))
+	continue;
+
+      upper = MIN (upper, line_width);
+      if (break_at >= 0)
+	{
+	  widest = MAX (widest, width_at_break);
+	  lower = MAX (lower, ink_at_break);
+	  line_width -= width_at_break;
+	  ink_width -= width_at_break;
+	}
+      else if (line_width > text->advances[i])
+	{
+	  widest = MAX (widest, line_width - text->advances[i]);
+	  lower = MAX (lower, prev_ink_width);
+	  line_width = ink_width = text->advances[i];
+	}
+      else
+	{
+	  /* A single character that is wider than the line.  */
+	  overfull = TRUE;
+	  continue;
+	}
+
+      overfull |= line_width > width;
+      break_at = -1;
+      lines++;
+    }
+
+  *text_width = MAX (widest, line_width);
+  *text_height = (gint64) lines * text->height / text->n_lines;
+
+  /* If a line is wider than WIDTH, it is broken at a different place
+     as soon as WIDTH gets smaller.  */
+  lower = MAX (lower, ink_width);
+  *min_width = overfull ? width : lower;
+  *max_width = upper;
+}
+
+/* Return the measurements of the label, if they are still valid.  */
+static GtkLayoutableText *
+gtk_label_layoutable_get_text (GtkLayoutableData    *data)
+{
+  if (data->text
+      && (data->text->style_generation != data->style_generation
+	  || data->text->text_revision != data->text_revision))
+    {
+      gtk_layoutable_text_free (data->text);
+      data->text = NULL;
+    }
+
+  return data->text;
+}
+
+/* The label draws its own PangoLayout, so the width that the label was
+   reflowed at is given to Pango only when the label is drawn.  If
+   Pango does not agree on the height, the label is laid out again,
+   this time by Pango.  */
+static gboolean
+gtk_label_layoutable_expose (GtkWidget            *widget,
+                             GdkEventExpose       *event,
+                             GtkLayoutableData    *data)
+{
+  GtkLabel *label = GTK_LABEL (widget);
+  PangoLayout *layout;
+  PangoRectangle rect;
+  gdouble start;
+
+  if (!data->width_pending)
+    return FALSE;
+
+  data->width_pending = FALSE;
+  layout = gtk_label_get_layout (label);
+
+  start = _gtk_layout_stats_begin (widget, GTK_LAYOUT_STATS_PANGO_LAYOUT);
+  pango_layout_set_width (layout, data->pending_width * PANGO_SCALE);
+  pango_layout_get_extents (layout, NULL, &rect);
+  _gtk_layout_stats_end (widget, GTK_LAYOUT_STATS_PANGO_LAYOUT, start);
+
+  if (data->text
+      && rect.height / PANGO_SCALE + label->misc.ypad * 2 != widget->allocation.height)
+    {
+      data->text->inexact = TRUE;
+      data->cache_valid = FALSE;
+      gtk_widget_queue_resize (widget);
+    }
+
+  return FALSE;
+}
+
+static gboolean
+gtk_label_layoutable_cache_contains (GtkLayoutableData    *data,
+                                     gint                  width)
+{
+  return (data->cache_valid
+	  && width * PANGO_SCALE >= data->cache_min_width
+	  && width * PANGO_SCALE < data->cache_max_width
+	  && data->cache_style_generation == data->style_generation
+	  && data->cache_text_revision == data->text_revision);
+}
+
+/* If the width is in the range of the cache, the lines are broken at
+   the same places and Pango does not need to see the label at all;
+   the layout keeps its old width.  */
+static gboolean
+gtk_label_layoutable_cache_lookup (GtkLabel             *label,
+                                   GtkLayoutableData    *data,
+                                   PangoLayout          *layout,
+                                   GtkAllocation        *allocation)
+{
+  gint layout_width;
+
+  if (!gtk_label_layoutable_cache_contains (data, allocation->width)
+      || GTK_LAYOUTABLE_ALLOC_NEEDED (label))
+    return FALSE;
+
+  /* GtkLabel throws away its layout when the text or the style change;
+     if it did so behind our back, the new layout has a different width
+     and it needs to be measured again.  A pending width is set on the
+     layout when it is drawn, whichever it is.  */
+  layout_width = data->width_pending
+    ? data->pending_width * PANGO_SCALE : pango_layout_get_width (layout);
+  if (layout_width < data->cache_min_width
+      || layout_width >= data->cache_max_width)
+    return FALSE;
+
+  allocation->width = data->cache_result.width;
+  allocation->height = data->cache_result.height;
+  return TRUE;
+}
+
+static void
+gtk_label_layoutable_cache_store (GtkLabel             *label,
+                                  GtkLayoutableData    *data,
+                                  gint                  min_width,
+                                  gint                  max_width,
+                                  GtkAllocation        *allocation)
+{
+  data->cache_min_width = min_width;
+  data->cache_max_width = max_width;
+  data->cache_style_generation = data->style_generation;
+  data->cache_text_revision = data->text_revision;
+  data->cache_result.width = allocation->width;
+  data->cache_result.height = allocation->height;
+  data->cache_valid = TRUE;
+}
+
 static void
 gtk_label_layoutable_size_allocate (GtkLayoutable        *layoutable,
                                     GtkAllocation        *allocation)
@@ -186,24 +1404,187 @@ gtk_label_layoutable_size_allocate (GtkLayoutable        *layoutable,
 
   if (gtk_label_get_line_wrap (label))
     {
+      GtkLayoutableData *data;
+      GtkLayoutableText *text;
+      GtkMeasurement measurement;
+      PangoFontDescription *font;
       PangoLayout *layout;
       PangoRectangle rect;
+      gdouble start;
+      gint width, min_width, max_width;
+      gint text_width, text_height;
+
+      /* Do this first, it bumps the text revision the first time.  */
+      gtk_misc_set_alignment (&label->misc, 0.0, 0.0);
 
-      /* Make it span the entire line.  */
+      data = gtk_layoutable_get_data (layoutable);
       layout = gtk_label_get_layout (label);
-      pango_layout_set_width (layout, allocation->width * PANGO_SCALE);
-      pango_layout_get_extents (layout, NULL, &rect);
+      font = GTK_WIDGET (label)->style->font_desc;
+      width = allocation->width;
+
+      if (!gtk_label_layoutable_cache_lookup (label, data, layout, allocation))
+	{
+	  min_width = width * PANGO_SCALE;
+	  max_width = min_width + 1;
+
+	  text = gtk_label_layoutable_get_text (data);
+	  if (text && !text->inexact)
+	    {
+	      gtk_layoutable_text_reflow (text, width * PANGO_SCALE,
+					  &rect.width, &rect.height,
+					  &min_width, &max_width);
+	      data->pending_width = width;
+	      data->width_pending = TRUE;
+	    }
+	  else if (_gtk_measure_cache_lookup (layout, font, width * PANGO_SCALE,
+					      &measurement))
+	    {
+	      /* Another label with the same text was measured.  Setting
+		 the width only invalidates the layout; it is laid out
+		 again when it is drawn.  */
+	      pango_layout_set_width (layout, width * PANGO_SCALE);
+	      rect.width = measurement.width;
+	      rect.height = measurement.height;
+	      data->width_pending = FALSE;
+	    }
+	  else
+	    {
+	      /* Make it span the entire line.  */
+	      start = _gtk_layout_stats_begin (GTK_WIDGET (label),
+					       GTK_LAYOUT_STATS_PANGO_LAYOUT);
+	      pango_layout_set_width (layout, width * PANGO_SCALE);
+	      _gtk_measure_cache_measure (layout, font, &measurement);
+	      _gtk_layout_stats_end (GTK_WIDGET (label), GTK_LAYOUT_STATS_PANGO_LAYOUT,
+				     start);
+	      rect.width = measurement.width;
+	      rect.height = measurement.height;
+	      data->width_pending = FALSE;
+
+	      /* Once the label is wrapped at a second width, it will
+		 probably be resized again; remember the advances.  They
+		 are trusted if they give the same height as Pango.  */
+	      if (!text
+		  && data->cache_valid
+		  && !gtk_label_layoutable_cache_contains (data, width)
+		  && data->cache_style_generation == data->style_generation
+		  && data->cache_text_revision == data->text_revision)
+		{
+		  text = data->text = gtk_label_layoutable_text_new (label, data, layout);
+		  gtk_layoutable_text_reflow (text, width * PANGO_SCALE,
+					      &text_width, &text_height,
+					      &min_width, &max_width);
+		  if (text_height != rect.height)
+		    {
+		      text->inexact = TRUE;
+		      min_width = width * PANGO_SCALE;
+		      max_width = min_width + 1;
+		    }
+
+		  if (!data->expose_connected)
+		    {
+		      g_signal_connect (label, "expose-event",
+					G_CALLBACK (gtk_label_layoutable_expose), data);
+		      data->expose_connected = TRUE;
+		    }
+		}
+	    }
+
+	  /* Unless the lines are aligned to the left, the label looks
+	     different at each width.  */
+	  if (gtk_label_get_justify (label) != GTK_JUSTIFY_LEFT
+	      || gtk_widget_get_direction (GTK_WIDGET (label)) == GTK_TEXT_DIR_RTL)
+	    {
+	      min_width = width * PANGO_SCALE;
+	      max_width = min_width + 1;
+	    }
 
-      allocation->width = rect.width / PANGO_SCALE + label->misc.xpad * 2;
-      allocation->height = rect.height / PANGO_SCALE + label->misc.ypad * 2;
+	  allocation->width = rect.width / PANGO_SCALE + label->misc.xpad * 2;
+	  allocation->height = rect.height / PANGO_SCALE + label->misc.ypad * 2;
+	  gtk_label_layoutable_cache_store (label, data, min_width, max_width,
+					    allocation);
+	}
 
-      gtk_misc_set_alignment (&label->misc, 0.0, 0.0);
-      gtk_widget_size_allocate (GTK_WIDGET (label), allocation);
+      gtk_layoutable_widget_size_allocate (GTK_WIDGET (label), allocation);
     }
 
   else
     (gtk_label_parent_layoutable_iface->size_allocate) (layoutable, allocation);
 }
+
+static void
+gtk_label_get_estimate_metrics (GtkLabel *label)
+{
+  GtkWidget *widget = GTK_WIDGET (label);
+  PangoContext *context;
+  PangoFontMetrics *metrics;
+
+  /* Almost all labels use the same font, so one entry is enough.  */
+  if (estimate_font
+      && pango_font_description_equal (estimate_font, widget->style->font_desc))
+    return;
+
+  if (estimate_font)
+    pango_font_description_free (estimate_font);
+
+  context = gtk_widget_get_pango_context (widget);
+  metrics = pango_context_get_metrics (context, widget->style->font_desc,
+				       pango_context_get_language (context));
+
+  estimate_font = pango_font_description_copy (widget->style->font_desc);
+  estimate_char_width =
+    MAX (pango_font_metrics_get_approximate_char_width (metrics), 1);
+  estimate_line_height =
+    pango_font_metrics_get_ascent (metrics) + pango_font_metrics_get_descent (metrics);
+  pango_font_metrics_unref (metrics);
+}
+
+static gint
+gtk_label_layoutable_estimate_height (GtkLayoutable        *layoutable,
+                                      gint                  width)
+{
+  GtkLabel *label = GTK_LABEL (layoutable);
+  GtkLayoutableText *text;
+  const gchar *p;
+  gint chars_per_line;
+  gint chars, lines;
+  gint text_width, text_height;
+  gint min_width, max_width;
+
+  if (!gtk_label_get_line_wrap (label))
+    return (gtk_label_parent_layoutable_iface->estimate_height) (layoutable, width);
+
+  /* If the label was measured before, the estimate is almost exact.  */
+  text = gtk_label_layoutable_get_text (gtk_layoutable_get_data (layoutable));
+  if (text && !text->inexact)
+    {
+      gtk_layoutable_text_reflow (text, width * PANGO_SCALE,
+				  &text_width, &text_height,
+				  &min_width, &max_width);
+      return text_height / PANGO_SCALE + label->misc.ypad * 2;
+    }
+
+  /* Assume that every character has the average width, and count
+     the lines of each paragraph.  */
+  gtk_label_get_estimate_metrics (label);
+  chars_per_line = (width - label->misc.xpad * 2) * PANGO_SCALE / estimate_char_width;
+  chars_per_line = MAX (chars_per_line, 1);
+
+  lines = chars = 0;
+  for (p = gtk_label_get_text (label); ; p = g_utf8_next_char (p))
+    {
+      if (*p == '\n' || *p == '\0')
+	{
+	  lines += MAX ((chars + chars_per_line - 1) / chars_per_line, 1);
+	  chars = 0;
+	  if (*p == '\0')
+	    break;
+	}
+      else
+	chars++;
+    }
+
+  return PANGO_PIXELS (lines * estimate_line_height) + label->misc.ypad * 2;
+}
 
 static void gtk_box_children_size_request (GtkWidget *child,
                                            gpointer   client_data);
@@ -211,6 +1592,15 @@ static void gtk_box_layoutable_size_request  (GtkLayoutable        *layoutable,
                                                GtkRequisition       *requisition);
 static void gtk_hbox_layoutable_size_allocate (GtkLayoutable        *layoutable,
                                                GtkAllocation        *allocation);
+static void gtk_hbox_layoutable_move          (GtkLayoutable        *layoutable,
+                                               gint                  dx,
+                                               gint                  dy);
+static void gtk_box_layoutable_move           (GtkLayoutable        *layoutable,
+                                               GtkLayoutableIface   *parent_iface,
+                                               gint                  dx,
+                                               gint                  dy);
+static gint gtk_hbox_layoutable_estimate_height (GtkLayoutable      *layoutable,
+                                                 gint                width);
 
 static GtkLayoutableIface    *gtk_hbox_parent_layoutable_iface;
 
@@ -220,6 +1610,8 @@ gtk_hbox_layoutable_init (GtkLayoutableIface *iface)
   gtk_hbox_parent_layoutable_iface = g_type_interface_peek_parent (iface);
   iface->size_request = gtk_box_layoutable_size_request;
   iface->size_allocate = gtk_hbox_layoutable_size_allocate;
+  iface->move = gtk_hbox_layoutable_move;
+  iface->estimate_height = gtk_hbox_layoutable_estimate_height;
 }
 
 static void
@@ -275,14 +1667,122 @@ gtk_box_layoutable_size_request  (GtkLayoutable        *layoutable,
   requisition->height += 2 * container->border_width;
 }
 
+/* A removed child is the only way for a GtkBoxChild to be freed, and
+   then a new one could take its place at the same address.  */
+static void
+gtk_box_layoutable_remove (GtkContainer      *container,
+                           GtkWidget         *widget,
+                           GtkLayoutableData *data)
+{
+  data->children_valid = FALSE;
+}
+
+/* Return the visible children of BOX in layout order.  The list of
+   children is only walked if a resize was queued on the box since the
+   last call, and the array is only filled again from the first child
+   that changed.  */
+static GtkLayoutableChild *
+gtk_box_layoutable_get_children (GtkBox            *box,
+                                 GtkLayoutableData *data,
+                                 gint              *n_children)
+{
+  GList *list;
+  gint i, j, n;
+  gboolean changed;
+
+  if (data->children_valid
+      && !GTK_LAYOUTABLE_ALLOC_NEEDED (box)
+      && !data->resize_queued)
+    {
+      *n_children = data->n_children;
+      return data->children;
+    }
+
+  if (!data->remove_connected)
+    {
+      g_signal_connect (box, "remove",
+			G_CALLBACK (gtk_box_layoutable_remove), data);
+      data->remove_connected = TRUE;
+    }
+
+  n = 0;
+  for (list = box->children; list; list = list->next)
+    {
+      GtkBoxChild *child_info = list->data;
+      if (GTK_WIDGET_VISIBLE (child_info->widget))
+	n++;
+    }
+
+  changed = !data->children_valid || n != data->n_children;
+  if (n != data->n_children)
+    {
+      data->children = g_renew (GtkLayoutableChild, data->children, n);
+      data->n_children = n;
+    }
+
+  /* The GTK_PACK_END children come last, in reverse order.  */
+  i = 0;
+  j = n;
+  for (list = box->children; list; list = list->next)
+    {
+      GtkBoxChild *child_info = list->data;
+      GtkLayoutableChild *child;
+
+      if (!GTK_WIDGET_VISIBLE (child_info->widget))
+	continue;
+
+      child = (child_info->pack == GTK_PACK_START
+	       ? &data->children[i++] : &data->children[--j]);
+      if (changed || child->info != child_info)
+	{
+	  changed = TRUE;
+	  gtk_layoutable_child_init (child, GTK_LAYOUTABLE (child_info->widget));
+	  child->info = child_info;
+	}
+    }
+
+  if (changed)
+    data->children_serial++;
+
+  data->children_valid = TRUE;
+  *n_children = n;
+  return data->children;
+}
+
+static void
+gtk_box_layoutable_move (GtkLayoutable        *layoutable,
+                         GtkLayoutableIface   *parent_iface,
+                         gint                  dx,
+                         gint                  dy)
+{
+  GtkWidget *widget = GTK_WIDGET (layoutable);
+  GtkBox *box = GTK_BOX (layoutable);
+  GtkLayoutableChild *children;
+  gint i, n;
+
+  if (box->homogeneous)
+    {
+      (parent_iface->move) (layoutable, dx, dy);
+      return;
+    }
+
+  widget->allocation.x += dx;
+  widget->allocation.y += dy;
+  children = gtk_box_layoutable_get_children (box,
+					      gtk_layoutable_get_data (layoutable),
+					      &n);
+  for (i = 0; i < n; i++)
+    if (gtk_widget_get_child_visible (children[i].info->widget))
+      gtk_layoutable_child_move (&children[i], dx, dy);
+}
+
 static void
 gtk_hbox_layoutable_size_allocate (GtkLayoutable        *layoutable,
                                    GtkAllocation        *allocation)
 {
   GtkBox *box = GTK_BOX (layoutable);
-  guint pack = GTK_PACK_START;
-  GList *list;
-  gint i;
+  GtkLayoutableChild *children;
+  gint i, n;
   gint border_width;
   gint row_height, row_width;
   gint available_width;
@@ -299,45 +1799,34 @@ gtk_hbox_layoutable_size_allocate (GtkLayoutable        *layoutable,
   row_width = border_width;
   available_width = allocation->width - border_width;
 
+  children = gtk_box_layoutable_get_children (box,
+					      gtk_layoutable_get_data (layoutable),
+					      &n);
   allocation->width = 0;
-  for (i = 0; i < 2; i++, pack = GTK_PACK_END)
-    {
-      list = pack == GTK_PACK_END ? g_list_last (box->children) : box->children;
-      while (list)
-        {
-          GtkBoxChild *child_info = list->data;
-          GtkLayoutable *child;
-          GtkRequisition child_requisition;
-
-          if (child_info->pack == pack
-	      && GTK_WIDGET_VISIBLE (child_info->widget))
-            {
-	      child = GTK_LAYOUTABLE (child_info->widget);
-	      gtk_widget_get_child_requisition (child_info->widget,
-					        &child_requisition);
-
-	      if (row_width + child_requisition.width > available_width)
-	        {
-	          /* Tell the parent about our actual allocation.  */
-	          allocation->width = MAX (allocation->width, row_width + border_width);
-	          allocation->height += row_height + box->spacing;
-	          row_width = border_width;
-	          row_height = 0;
-	        }
-
-	      child_allocation.x = allocation->x + row_width + child_info->padding;
-	      child_allocation.y = allocation->y + allocation->height;
-	      child_allocation.width = available_width;
-	      child_allocation.height = 0;
-	      gtk_layoutable_size_allocate (child, &child_allocation);
-
-	      row_width += child_allocation.width + box->spacing +
-		           child_info->padding * 2;
-	      row_height = MAX (row_height, child_allocation.height);
-            }
-
-	  list = pack == GTK_PACK_END ? list->prev : list->next;
+  for (i = 0; i < n; i++)
+    {
+      GtkBoxChild *child_info = children[i].info;
+      GtkRequisition child_requisition;
+
+      gtk_widget_get_child_requisition (child_info->widget, &child_requisition);
+      if (row_width + child_requisition.width > available_width)
+	{
+	  /* Tell the parent about our actual allocation.  */
+	  allocation->width = MAX (allocation->width, row_width + border_width);
+	  allocation->height += row_height + box->spacing;
+	  row_width = border_width;
+	  row_height = 0;
 	}
+
+      child_allocation.x = allocation->x + row_width + child_info->padding;
+      child_allocation.y = allocation->y + allocation->height;
+      child_allocation.width = available_width;
+      child_allocation.height = 0;
+      gtk_layoutable_child_size_allocate (&children[i], &child_allocation);
+
+      row_width += child_allocation.width + box->spacing +
+		   child_info->padding * 2;
+      row_height = MAX (row_height, child_allocation.height);
     }
 
   allocation->width = MAX (allocation->width, row_width + border_width);
@@ -345,10 +1834,79 @@ gtk_hbox_layoutable_size_allocate (GtkLayoutable        *layoutable,
     allocation->height += border_width - box->spacing;
   else
     allocation->height += row_height + border_width;
+
+  GTK_WIDGET (box)->allocation = *allocation;
+}
+
+static void
+gtk_hbox_layoutable_move (GtkLayoutable        *layoutable,
+                          gint                  dx,
+                          gint                  dy)
+{
+  gtk_box_layoutable_move (layoutable, gtk_hbox_parent_layoutable_iface, dx, dy);
+}
+
+static gint
+gtk_hbox_layoutable_estimate_height (GtkLayoutable        *layoutable,
+                                     gint                  width)
+{
+  GtkBox *box = GTK_BOX (layoutable);
+  GtkLayoutableChild *children;
+  gint i, n;
+  gint border_width;
+  gint row_height, row_width;
+  gint available_width;
+  gint height;
+
+  if (box->homogeneous)
+    return (gtk_hbox_parent_layoutable_iface->estimate_height) (layoutable, width);
+
+  /* Same as gtk_hbox_layoutable_size_allocate, but assume that
+     every child is as wide as its requisition.  */
+  border_width = GTK_CONTAINER (box)->border_width;
+  row_height = 0;
+  row_width = border_width;
+  available_width = width - border_width;
+
+  children = gtk_box_layoutable_get_children (box,
+					      gtk_layoutable_get_data (layoutable),
+					      &n);
+  height = 0;
+  for (i = 0; i < n; i++)
+    {
+      GtkBoxChild *child_info = children[i].info;
+      GtkRequisition child_requisition;
+
+      gtk_widget_get_child_requisition (child_info->widget, &child_requisition);
+      if (row_width + child_requisition.width > available_width)
+	{
+	  height += row_height + box->spacing;
+	  row_width = border_width;
+	  row_height = 0;
+	}
+
+      row_width += child_requisition.width + box->spacing +
+		   child_info->padding * 2;
+      row_height = MAX (row_height,
+			gtk_layoutable_child_estimate_height (&children[i],
+							      available_width));
+    }
+
+  if (row_height == 0)
+    height += border_width - box->spacing;
+  else
+    height += row_height + border_width;
+
+  return height;
 }
 
 static void gtk_vbox_layoutable_size_allocate (GtkLayoutable        *layoutable,
                                                GtkAllocation        *allocation);
+static void gtk_vbox_layoutable_move          (GtkLayoutable        *layoutable,
+                                               gint                  dx,
+                                               gint                  dy);
+static gint gtk_vbox_layoutable_estimate_height (GtkLayoutable      *layoutable,
+                                                 gint                width);
 
 static GtkLayoutableIface    *gtk_vbox_parent_layoutable_iface;
 
@@ -358,6 +1916,8 @@ gtk_vbox_layoutable_init (GtkLayoutableIface *iface)
   gtk_vbox_parent_layoutable_iface = g_type_interface_peek_parent (iface);
   iface->size_request = gtk_box_layoutable_size_request;
   iface->size_allocate = gtk_vbox_layoutable_size_allocate;
+  iface->move = gtk_vbox_layoutable_move;
+  iface->estimate_height = gtk_vbox_layoutable_estimate_height;
 }
 
 static void
@@ -375,16 +1935,193 @@ gtk_vbox_add_layoutable_interface ()
                                &layoutable_info);
 }
 
+/* The Fenwick tree is stored 1-based, tree[i] holds the sum of the
+   sizes from i - (i & -i) to i - 1.  */
+static void
+gtk_layoutable_index_build (GtkLayoutableIndex *index)
+{
+  gint i, j;
+
+  index->tree[0] = 0;
+  for (i = 1; i <= index->n_children; i++)
+    index->tree[i] = index->sizes[i - 1];
+
+  for (i = 1; i <= index->n_children; i++)
+    {
+      j = i + (i & -i);
+      if (j <= index->n_children)
+	index->tree[j] += index->tree[i];
+    }
+}
+
+static void
+gtk_layoutable_index_set_size (GtkLayoutableIndex *index,
+                               gint                nth,
+                               gint                size)
+{
+  gint i, delta;
+
+  delta = size - index->sizes[nth];
+  index->sizes[nth] = size;
+  for (i = nth + 1; i <= index->n_children; i += i & -i)
+    index->tree[i] += delta;
+}
+
+/* Return the space taken by the first NTH children.  */
+static gint
+gtk_layoutable_index_sum (GtkLayoutableIndex *index,
+                          gint                nth)
+{
+  gint sum = 0;
+
+  for (; nth > 0; nth -= nth & -nth)
+    sum += index->tree[nth];
+
+  return sum;
+}
+
+/* Return the child that contains the offset Y, or n_children if
+   Y is past the end.  */
+static gint
+gtk_layoutable_index_find (GtkLayoutableIndex *index,
+                           gint                y)
+{
+  gint i, step;
+
+  for (step = 1; step * 2 <= index->n_children; step *= 2)
+    ;
+
+  for (i = 0; step > 0; step /= 2)
+    if (i + step <= index->n_children && index->tree[i + step] <= y)
+      {
+	i += step;
+	y -= index->tree[i];
+      }
+
+  return i;
+}
+
+/* Only the children that queued a resize can have changed height,
+   so estimate them again and update their sizes in O(log n) each.
+   The others keep the size that the last pass stored.  */
+static void
+gtk_vbox_layoutable_update_dirty (GtkBox             *box,
+                                  GtkLayoutableIndex *index,
+                                  gint                base)
+{
+  GtkLayoutableChild *child;
+  gint i, size, old_y;
+  gboolean above;
+
+  /* Keep the content at the anchor in place.  Once a child that
+     changed is not above the anchor, none of the following ones is.  */
+  above = layout_anchored;
+  for (i = 0; i < index->n_children; i++)
+    {
+      child = &index->children[i];
+      if (!GTK_LAYOUTABLE_ALLOC_NEEDED (child->layoutable)
+	  && !child->data->resize_queued)
+	continue;
+
+      size = gtk_layoutable_child_estimate_height (child, index->width)
+	     + child->info->padding * 2 + box->spacing;
+      if (size == index->sizes[i])
+	continue;
+
+      /* The children before this one moved by layout_anchor_delta
+	 already, if they were above the anchor.  */
+      old_y = base - layout_anchor_delta + gtk_layoutable_index_sum (index, i);
+      if (above && old_y + index->sizes[i] <= layout_anchor)
+	layout_anchor_delta += size - index->sizes[i];
+      else
+	above = FALSE;
+
+      gtk_layoutable_index_set_size (index, i, size);
+    }
+}
+
+/* Bring the index up to date with the children of BOX and with their
+   heights at WIDTH.  When the children or the width change this is
+   O(n); otherwise only the children that queued a resize are looked
+   at again.  Scrolling only needs to visit the children that are
+   visible.  */
+static GtkLayoutableIndex *
+gtk_vbox_layoutable_update_index (GtkBox             *box,
+                                  GtkLayoutableData  *data,
+                                  gint                width,
+                                  gint                base)
+{
+  GtkLayoutableIndex *index = data->index;
+  GtkLayoutableChild *children;
+  gint i, n;
+  gint size, old_y;
+  gboolean rebuild;
+
+  children = gtk_box_layoutable_get_children (box, data, &n);
+  rebuild = (index == NULL || index->children_serial != data->children_serial);
+  if (!rebuild
+      && index->width == width
+      && index->spacing == box->spacing)
+    {
+      /* The array may have moved even if it holds the same children.  */
+      index->children = children;
+      gtk_vbox_layoutable_update_dirty (box, index, base);
+      return index;
+    }
+
+  if (rebuild)
+    {
+      if (index)
+	gtk_layoutable_index_free (index);
+
+      index = data->index = g_new0 (GtkLayoutableIndex, 1);
+      index->n_children = n;
+      index->children_serial = data->children_serial;
+      index->sizes = g_new0 (gint, n);
+      index->tree = g_new (gint, n + 1);
+
+      /* We do not know which children were allocated.  */
+      index->first_allocated = 0;
+      index->last_allocated = n;
+    }
+
+  /* The array may have moved even if it holds the same children.  */
+  index->children = children;
+
+  /* Keep the content at the anchor in place.  When the box was rebuilt
+     the old positions are not known, so this is not possible.  */
+  old_y = base - layout_anchor_delta;
+  for (i = 0; i < n; i++)
+    {
+      size = gtk_layoutable_child_estimate_height (&children[i], width)
+	     + children[i].info->padding * 2 + box->spacing;
+
+      if (!rebuild
+	  && layout_anchored
+	  && old_y + index->sizes[i] <= layout_anchor)
+	layout_anchor_delta += size - index->sizes[i];
+
+      old_y += index->sizes[i];
+      index->sizes[i] = size;
+    }
+
+  index->width = width;
+  index->spacing = box->spacing;
+  gtk_layoutable_index_build (index);
+  return index;
+}
+
 static void
 gtk_vbox_layoutable_size_allocate (GtkLayoutable        *layoutable,
                                    GtkAllocation        *allocation)
 {
   GtkBox *box = GTK_BOX (layoutable);
-  guint pack = GTK_PACK_START;
-  GList *list;
-  gint i;
+  GtkLayoutableData *data;
+  GtkLayoutableIndex *index;
+  gint i, first, last;
   gint border_width;
   gint available_width;
+  gint y, size;
   GtkAllocation child_allocation;
 
   if (box->homogeneous)
@@ -395,38 +2132,116 @@ gtk_vbox_layoutable_size_allocate (GtkLayoutable        *layoutable,
 
   border_width = GTK_CONTAINER (box)->border_width;
   available_width = allocation->width - 2 * border_width;
+  if (box->children)
+    layout_can_cull = TRUE;
+
+  data = gtk_layoutable_get_data (layoutable);
+  index = data->index;
+  if (!index
+      || !data->children_valid
+      || GTK_LAYOUTABLE_ALLOC_NEEDED (box)
+      || data->resize_queued
+      || index->width != available_width
+      || index->spacing != box->spacing)
+    index = gtk_vbox_layoutable_update_index (box, data, available_width,
+					      allocation->y + border_width);
+
+  /* Start from the first visible child, and stop after the last.  */
+  first = 0;
+  if (visible_area)
+    first = gtk_layoutable_index_find (index, visible_area->y - allocation->y -
+					      border_width);
+
+  y = allocation->y + border_width + gtk_layoutable_index_sum (index, first);
+  for (i = first; i < index->n_children; i++)
+    {
+      GtkBoxChild *child_info = index->children[i].info;
 
-  allocation->height = border_width;
-  for (i = 0; i < 2; i++, pack = GTK_PACK_END)
-    {
-      list = pack == GTK_PACK_END ? g_list_last (box->children) : box->children;
-      while (list)
-        {
-          GtkBoxChild *child_info = list->data;
-          GtkLayoutable *child;
-          if (child_info->pack == pack
-	      && GTK_WIDGET_VISIBLE (child_info->widget))
-            {
-	      child = GTK_LAYOUTABLE (child_info->widget);
-	      child_allocation.x = allocation->x + border_width;
-	      child_allocation.y = allocation->y + allocation->height +
-			           child_info->padding;
-	      child_allocation.width = available_width;
-	      child_allocation.height = 0;
-	      gtk_layoutable_size_allocate (child, &child_allocation);
-
-	      /* Tell the parent about our actual allocation.  */
-	      allocation->width = MAX (allocation->width, child_allocation.width);
-	      allocation->height += child_allocation.height + box->spacing +
-				    child_info->padding * 2;
-	    }
+      if (visible_area && y >= visible_area->y + visible_area->height)
+	break;
+
+      child_allocation.x = allocation->x + border_width;
+      child_allocation.y = y + child_info->padding;
+      child_allocation.width = available_width;
+      child_allocation.height = 0;
+      gtk_layoutable_allocate_child (&index->children[i], &child_allocation);
+
+      /* Tell the parent about our actual allocation.  */
+      allocation->width = MAX (allocation->width, child_allocation.width);
+      size = child_allocation.height + child_info->padding * 2 + box->spacing;
+      if (size != index->sizes[i])
+	gtk_layoutable_index_set_size (index, i, size);
+
+      y += size;
+    }
 
-	  list = pack == GTK_PACK_END ? list->prev : list->next;
-        }
+  /* Cull the children that went out of view since the last pass,
+     or add them to those allocated if they touch.  */
+  last = i;
+  if (layout_keep_allocated
+      && index->allocated_known
+      && first <= index->last_allocated
+      && last >= index->first_allocated)
+    {
+      first = MIN (first, index->first_allocated);
+      last = MAX (last, index->last_allocated);
+    }
+  else
+    {
+      for (i = index->first_allocated; i < index->last_allocated; i++)
+	if (i < first || i >= last)
+	  gtk_layoutable_cull (index->children[i].info->widget, FALSE);
     }
 
-  if (allocation->height > border_width)
+  index->first_allocated = first;
+  index->last_allocated = last;
+  index->allocated_known = TRUE;
+  if (first > 0 || last < index->n_children)
+    layout_culled = TRUE;
+
+  allocation->height = border_width + gtk_layoutable_index_sum (index, index->n_children);
+  if (index->n_children > 0)
     allocation->height -= box->spacing;
 
   allocation->height += border_width;
+  GTK_WIDGET (box)->allocation = *allocation;
+}
+
+static void
+gtk_vbox_layoutable_move (GtkLayoutable        *layoutable,
+                          gint                  dx,
+                          gint                  dy)
+{
+  gtk_box_layoutable_move (layoutable, gtk_vbox_parent_layoutable_iface, dx, dy);
+}
+
+static gint
+gtk_vbox_layoutable_estimate_height (GtkLayoutable        *layoutable,
+                                     gint                  width)
+{
+  GtkBox *box = GTK_BOX (layoutable);
+  GtkLayoutableChild *children;
+  gint i, n;
+  gint border_width;
+  gint available_width;
+  gint height;
+
+  if (box->homogeneous)
+    return (gtk_vbox_parent_layoutable_iface->estimate_height) (layoutable, width);
+
+  border_width = GTK_CONTAINER (box)->border_width;
+  available_width = width - 2 * border_width;
+
+  children = gtk_box_layoutable_get_children (box,
+					      gtk_layoutable_get_data (layoutable),
+					      &n);
+  height = border_width;
+  for (i = 0; i < n; i++)
+    height += gtk_layoutable_child_estimate_height (&children[i], available_width)
+	      + box->spacing + children[i].info->padding * 2;
+
+  if (height > border_width)
+    height -= box->spacing;
+
+  return height + border_width;
 }
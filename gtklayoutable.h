@@ -43,6 +43,11 @@ struct _GtkLayoutableIface
 				GtkRequisition       *requisition);
   void      (*size_allocate)   (GtkLayoutable        *layoutable,
 				GtkAllocation        *allocation);
+  void      (*move)            (GtkLayoutable        *layoutable,
+				gint                  dx,
+				gint                  dy);
+  gint      (*estimate_height) (GtkLayoutable        *layoutable,
+				gint                  width);
 };
 
 
@@ -53,6 +58,34 @@ void      gtk_layoutable_size_request          (GtkLayoutable        *layoutable
 						GtkRequisition       *requisition);
 void      gtk_layoutable_size_allocate         (GtkLayoutable        *layoutable,
 						GtkAllocation        *allocation);
+void      gtk_layoutable_size_allocate_visible (GtkLayoutable        *layoutable,
+						GtkAllocation        *allocation,
+						const GdkRectangle   *visible,
+						gint                 *anchor);
+void      gtk_layoutable_size_allocate_more    (GtkLayoutable        *layoutable,
+						GtkAllocation        *allocation,
+						const GdkRectangle   *area,
+						gint                 *anchor);
+void      gtk_layoutable_track_damage          (GdkRegion            *damage);
+gint      gtk_layoutable_estimate_height       (GtkLayoutable        *layoutable,
+						gint                  width);
+void      gtk_layoutable_set_estimated_height  (GtkLayoutable        *layoutable,
+						gint                  width,
+						gint                  height);
+gboolean  gtk_layoutable_is_allocated         (GtkLayoutable        *layoutable,
+						gint                  width);
+GtkWidget *gtk_layoutable_get_child_at_y       (GtkLayoutable        *layoutable,
+						gint                  y,
+						gint                 *nth);
+gboolean  gtk_layoutable_get_child_y           (GtkLayoutable        *layoutable,
+						gint                  nth,
+						gint                 *y);
+void      gtk_layoutable_propagate_expose      (GtkContainer         *container,
+						GtkWidget            *child,
+						GdkEventExpose       *event);
+void      gtk_layoutable_move                  (GtkLayoutable        *layoutable,
+						gint                  dx,
+						gint                  dy);
 
 G_END_DECLS
 
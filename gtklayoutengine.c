@@ -0,0 +1,818 @@
+/* gtklayoutengine.c
+ * Copyright (C) 2008 Free Software Foundation, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* The height-for-width layout of gtklayoutable.c, over a tree of plain
+   nodes instead of widgets.  Vertical boxes stack their children at
+   the full width, horizontal boxes flow their children into rows, and
+   text nodes ask a measuring function for their size.  Nothing here
+   needs a display, so layouts can be computed in batch processes; with
+   gtk_layout_engine_new_fake the results do not even depend on fonts.
+
+   The algorithms must be kept in sync with the GtkLayoutable
+   implementations of GtkVBox, GtkHBox and GtkLabel.  */
+
+#include <string.h>
+#include <glib.h>
+#include <pango/pango.h>
+#include "gtklayoutengine.h"
+
+struct _GtkLayoutEngine
+{
+  GtkLayoutMeasureFunc measure;
+  gpointer user_data;
+  GDestroyNotify notify;
+
+  /* Engines that measure the children of large vertical boxes in
+     other threads, and whether they are doing so.  The threads are
+     started the first time, one for each helper, and kept until the
+     engine is freed.  */
+  GPtrArray *helpers;
+  gboolean parallel;
+  GThreadPool *pool;
+  GMutex *mutex;
+  GCond *cond;
+  gint n_running;
+};
+
+/* The children of a vertical box, measured by several threads.  Each
+   thread takes the next PARALLEL_CHUNK children until none are left,
+   so that threads that got short texts take more of them.  */
+typedef struct _GtkLayoutParallelMeasure GtkLayoutParallelMeasure;
+
+struct _GtkLayoutParallelMeasure
+{
+  GtkLayoutNode **children;
+  gint n_children;
+  gint width;
+  volatile gint next;
+};
+
+typedef struct _GtkLayoutParallelWorker GtkLayoutParallelWorker;
+
+struct _GtkLayoutParallelWorker
+{
+  GtkLayoutEngine *engine;
+  GtkLayoutParallelMeasure *measure;
+
+  /* The engine whose helper this is.  */
+  GtkLayoutEngine *owner;
+};
+
+/* Vertical boxes with fewer children are laid out by one thread.  */
+#define PARALLEL_MIN_CHILDREN 256
+#define PARALLEL_CHUNK 16
+
+typedef struct _GtkLayoutFakeMetrics GtkLayoutFakeMetrics;
+
+struct _GtkLayoutFakeMetrics
+{
+  gint char_width;
+  gint line_height;
+};
+
+static void gtk_layout_engine_allocate_node (GtkLayoutEngine *engine,
+					     GtkLayoutNode   *node,
+					     gint             x,
+					     gint             y,
+					     gint             width);
+
+static GtkLayoutNode *
+gtk_layout_node_new (GtkLayoutNodeType type)
+{
+  GtkLayoutNode *node;
+
+  node = g_slice_new0 (GtkLayoutNode);
+  node->type = type;
+  node->visible = TRUE;
+  return node;
+}
+
+/**
+ * gtk_layout_node_new_vbox:
+ * @spacing: the space between children
+ *
+ * Creates a node that stacks its children vertically, like a
+ * #GtkVBox.
+ *
+ * Return value: a new #GtkLayoutNode
+ **/
+GtkLayoutNode *
+gtk_layout_node_new_vbox (gint spacing)
+{
+  GtkLayoutNode *node;
+
+  node = gtk_layout_node_new (GTK_LAYOUT_NODE_VBOX);
+  node->spacing = spacing;
+  return node;
+}
+
+/**
+ * gtk_layout_node_new_hbox:
+ * @spacing: the space between children
+ *
+ * Creates a node that puts its children side by side, and starts a
+ * new row when they do not fit, like a layoutable #GtkHBox.
+ *
+ * Return value: a new #GtkLayoutNode
+ **/
+GtkLayoutNode *
+gtk_layout_node_new_hbox (gint spacing)
+{
+  GtkLayoutNode *node;
+
+  node = gtk_layout_node_new (GTK_LAYOUT_NODE_HBOX);
+  node->spacing = spacing;
+  return node;
+}
+
+/**
+ * gtk_layout_node_new_text:
+ * @text: the text
+ * @wrap: whether the text wraps at the width it is allocated
+ *
+ * Creates a node that is as big as @text, like a #GtkLabel.
+ *
+ * Return value: a new #GtkLayoutNode
+ **/
+GtkLayoutNode *
+gtk_layout_node_new_text (const gchar *text,
+			  gboolean     wrap)
+{
+  GtkLayoutNode *node;
+
+  node = gtk_layout_node_new (GTK_LAYOUT_NODE_TEXT);
+  node->text = g_strdup (text ? text : "");
+  node->wrap = (wrap != FALSE);
+  return node;
+}
+
+/**
+ * gtk_layout_node_new_fixed:
+ * @width: the width of the node
+ * @height: the height of the node
+ *
+ * Creates a node that always has the same size.
+ *
+ * Return value: a new #GtkLayoutNode
+ **/
+GtkLayoutNode *
+gtk_layout_node_new_fixed (gint width,
+			   gint height)
+{
+  GtkLayoutNode *node;
+
+  node = gtk_layout_node_new (GTK_LAYOUT_NODE_FIXED);
+  node->request_width = width;
+  node->request_height = height;
+  return node;
+}
+
+/**
+ * gtk_layout_node_append:
+ * @parent: a box node
+ * @child: the node to add
+ * @padding: extra space around @child
+ * @pack_end: whether @child is packed at the end of @parent
+ *
+ * Adds @child as the last child of @parent.  Like with gtk_box_pack_end,
+ * the children that are packed at the end come after the others, in
+ * reverse order.
+ **/
+void
+gtk_layout_node_append (GtkLayoutNode *parent,
+			GtkLayoutNode *child,
+			gint           padding,
+			gboolean       pack_end)
+{
+  g_return_if_fail (parent != NULL);
+  g_return_if_fail (parent->type == GTK_LAYOUT_NODE_VBOX
+		    || parent->type == GTK_LAYOUT_NODE_HBOX);
+  g_return_if_fail (child != NULL && child->parent == NULL);
+
+  child->parent = parent;
+  child->padding = padding;
+  child->pack_end = (pack_end != FALSE);
+  child->prev = parent->last_child;
+  if (parent->last_child)
+    parent->last_child->next = child;
+  else
+    parent->children = child;
+  parent->last_child = child;
+}
+
+/**
+ * gtk_layout_node_set_text:
+ * @node: a text node
+ * @text: the new text
+ *
+ * Changes the text of @node.
+ **/
+void
+gtk_layout_node_set_text (GtkLayoutNode *node,
+			  const gchar   *text)
+{
+  g_return_if_fail (node != NULL && node->type == GTK_LAYOUT_NODE_TEXT);
+
+  g_free (node->text);
+  node->text = g_strdup (text ? text : "");
+}
+
+/**
+ * gtk_layout_node_free:
+ * @node: a #GtkLayoutNode
+ *
+ * Frees @node and all of its children.  @node must not have a parent.
+ **/
+void
+gtk_layout_node_free (GtkLayoutNode *node)
+{
+  GtkLayoutNode *child, *next;
+
+  g_return_if_fail (node != NULL);
+
+  for (child = node->children; child; child = next)
+    {
+      next = child->next;
+      child->parent = NULL;
+      gtk_layout_node_free (child);
+    }
+
+  g_free (node->text);
+  g_slice_free (GtkLayoutNode, node);
+}
+
+/**
+ * gtk_layout_engine_new:
+ * @func: the function that measures text
+ * @user_data: data for @func
+ * @notify: a function to free @user_data, or %NULL
+ *
+ * Creates a layout engine that measures text nodes with @func.
+ *
+ * Return value: a new #GtkLayoutEngine
+ **/
+GtkLayoutEngine *
+gtk_layout_engine_new (GtkLayoutMeasureFunc func,
+		       gpointer             user_data,
+		       GDestroyNotify       notify)
+{
+  GtkLayoutEngine *engine;
+
+  g_return_val_if_fail (func != NULL, NULL);
+
+  engine = g_new (GtkLayoutEngine, 1);
+  engine->measure = func;
+  engine->user_data = user_data;
+  engine->notify = notify;
+  engine->helpers = g_ptr_array_new ();
+  engine->parallel = FALSE;
+  engine->pool = NULL;
+  engine->mutex = NULL;
+  engine->cond = NULL;
+  engine->n_running = 0;
+  return engine;
+}
+
+/**
+ * gtk_layout_engine_add_helper:
+ * @engine: a #GtkLayoutEngine
+ * @helper: another #GtkLayoutEngine
+ *
+ * Adds an engine that measures some of the children of large vertical
+ * boxes in a thread of its own, while @engine measures the others.
+ * @helper must measure text like @engine, and must not share state
+ * with it; for Pango, this means a context from another font map.
+ * @engine takes ownership of @helper.
+ *
+ * The children are then placed by @engine, so the results are the
+ * same as without helpers.  The threads are started the first time
+ * they are needed and kept until @engine is freed, so helpers cannot
+ * be added after that.  g_thread_init() must have been called.
+ **/
+void
+gtk_layout_engine_add_helper (GtkLayoutEngine *engine,
+			      GtkLayoutEngine *helper)
+{
+  g_return_if_fail (engine != NULL);
+  g_return_if_fail (helper != NULL && helper != engine);
+  g_return_if_fail (engine->pool == NULL);
+
+  g_ptr_array_add (engine->helpers, helper);
+}
+
+static void
+gtk_layout_engine_measure_pango (const gchar *text,
+				 gint         width,
+				 gint        *text_width,
+				 gint        *text_height,
+				 gpointer     user_data)
+{
+  PangoLayout *layout;
+  PangoRectangle rect;
+
+  layout = pango_layout_new (PANGO_CONTEXT (user_data));
+  pango_layout_set_text (layout, text, -1);
+  pango_layout_set_wrap (layout, PANGO_WRAP_WORD);
+  pango_layout_set_width (layout, width < 0 ? -1 : width * PANGO_SCALE);
+  pango_layout_get_extents (layout, NULL, &rect);
+  g_object_unref (layout);
+
+  /* Truncate like gtk_label_layoutable_size_allocate.  */
+  *text_width = rect.width / PANGO_SCALE;
+  *text_height = rect.height / PANGO_SCALE;
+}
+
+/**
+ * gtk_layout_engine_new_for_pango:
+ * @context: a #PangoContext
+ *
+ * Creates a layout engine that measures text with Pango, wrapping at
+ * word boundaries like #GtkLabel does.  The context can come from a
+ * font map that does not need a display, such as the one returned by
+ * pango_cairo_font_map_get_default().
+ *
+ * Return value: a new #GtkLayoutEngine
+ **/
+GtkLayoutEngine *
+gtk_layout_engine_new_for_pango (PangoContext *context)
+{
+  g_return_val_if_fail (PANGO_IS_CONTEXT (context), NULL);
+
+  return gtk_layout_engine_new (gtk_layout_engine_measure_pango,
+				g_object_ref (context), g_object_unref);
+}
+
+/* Break each paragraph greedily at spaces; words that do not fit on
+   a line by themselves are broken anywhere.  */
+static void
+gtk_layout_engine_measure_fake (const gchar *text,
+				gint         width,
+				gint        *text_width,
+				gint        *text_height,
+				gpointer     user_data)
+{
+  GtkLayoutFakeMetrics *metrics = user_data;
+  const gchar *p;
+  gint chars_per_line, line, word, max_line, lines;
+
+  chars_per_line = width < 0 ? G_MAXINT : MAX (width / metrics->char_width, 1);
+  line = word = max_line = 0;
+  lines = 1;
+  for (p = text; ; p = g_utf8_next_char (p))
+    {
+      if (*p == ' ' || *p == '\n' || *p == '\0')
+	{
+	  /* Put the word on this line, or on new lines.  */
+	  if (line > 0 && line + 1 + word <= chars_per_line)
+	    line += 1 + word;
+	  else if (word > 0)
+	    {
+	      if (line > 0)
+		{
+		  max_line = MAX (max_line, line);
+		  lines++;
+		}
+	      lines += (word - 1) / chars_per_line;
+	      line = (word - 1) % chars_per_line + 1;
+	      max_line = MAX (max_line, MIN (word, chars_per_line));
+	    }
+
+	  word = 0;
+	  if (*p == '\n')
+	    {
+	      max_line = MAX (max_line, line);
+	      line = 0;
+	      lines++;
+	    }
+	  else if (*p == '\0')
+	    break;
+	}
+      else
+	word++;
+    }
+
+  max_line = MAX (max_line, line);
+  *text_width = max_line * metrics->char_width;
+  *text_height = lines * metrics->line_height;
+}
+
+/**
+ * gtk_layout_engine_new_fake:
+ * @char_width: the width of every character
+ * @line_height: the height of every line
+ *
+ * Creates a layout engine whose text nodes behave as if the font had
+ * fixed metrics, and that does not use Pango at all.  The results only
+ * depend on the text, which is useful to compare layouts and to time
+ * the layout code alone.
+ *
+ * Return value: a new #GtkLayoutEngine
+ **/
+GtkLayoutEngine *
+gtk_layout_engine_new_fake (gint char_width,
+			    gint line_height)
+{
+  GtkLayoutFakeMetrics *metrics;
+
+  g_return_val_if_fail (char_width > 0, NULL);
+  g_return_val_if_fail (line_height > 0, NULL);
+
+  metrics = g_new (GtkLayoutFakeMetrics, 1);
+  metrics->char_width = char_width;
+  metrics->line_height = line_height;
+  return gtk_layout_engine_new (gtk_layout_engine_measure_fake,
+				metrics, g_free);
+}
+
+/**
+ * gtk_layout_engine_free:
+ * @engine: a #GtkLayoutEngine
+ *
+ * Frees @engine.
+ **/
+void
+gtk_layout_engine_free (GtkLayoutEngine *engine)
+{
+  g_return_if_fail (engine != NULL);
+
+  if (engine->pool)
+    g_thread_pool_free (engine->pool, FALSE, TRUE);
+  if (engine->mutex)
+    {
+      g_cond_free (engine->cond);
+      g_mutex_free (engine->mutex);
+    }
+
+  if (engine->notify)
+    (* engine->notify) (engine->user_data);
+  g_ptr_array_foreach (engine->helpers, (GFunc) gtk_layout_engine_free, NULL);
+  g_ptr_array_free (engine->helpers, TRUE);
+  g_free (engine);
+}
+
+/* Iterate over the visible children in layout order: first the ones
+   packed at the start, then the ones packed at the end, backwards.  */
+static GtkLayoutNode *
+gtk_layout_node_next_child (GtkLayoutNode *node,
+			    GtkLayoutNode *child)
+{
+  gboolean pack_end;
+
+  pack_end = child ? child->pack_end : FALSE;
+  child = child ? (pack_end ? child->prev : child->next) : node->children;
+  for (;;)
+    {
+      for (; child; child = pack_end ? child->prev : child->next)
+	if (child->visible && child->pack_end == pack_end)
+	  return child;
+
+      if (pack_end)
+	return NULL;
+
+      pack_end = TRUE;
+      child = node->last_child;
+    }
+}
+
+/**
+ * gtk_layout_engine_request:
+ * @engine: a #GtkLayoutEngine
+ * @node: a #GtkLayoutNode
+ *
+ * Computes the requisition of @node and of its children.  Wrapped
+ * text nodes and the boxes that contain them do not know their height
+ * until they are allocated a width; like layoutable labels, they
+ * request no space.
+ **/
+void
+gtk_layout_engine_request (GtkLayoutEngine *engine,
+			   GtkLayoutNode   *node)
+{
+  GtkLayoutNode *child;
+
+  g_return_if_fail (engine != NULL);
+  g_return_if_fail (node != NULL);
+
+  switch (node->type)
+    {
+    case GTK_LAYOUT_NODE_VBOX:
+    case GTK_LAYOUT_NODE_HBOX:
+      node->request_width = node->request_height = 0;
+      for (child = gtk_layout_node_next_child (node, NULL); child;
+	   child = gtk_layout_node_next_child (node, child))
+	{
+	  gtk_layout_engine_request (engine, child);
+	  node->request_width = MAX (node->request_width, child->request_width);
+	  node->request_height = MAX (node->request_height, child->request_height);
+	}
+
+      node->request_width += 2 * node->border_width;
+      node->request_height += 2 * node->border_width;
+      break;
+
+    case GTK_LAYOUT_NODE_TEXT:
+      if (node->wrap)
+	node->request_width = node->request_height = 0;
+      else
+	{
+	  (* engine->measure) (node->text, -1,
+			       &node->request_width, &node->request_height,
+			       engine->user_data);
+	  node->request_width += node->xpad * 2;
+	  node->request_height += node->ypad * 2;
+	}
+      break;
+
+    case GTK_LAYOUT_NODE_FIXED:
+      break;
+    }
+}
+
+static void
+gtk_layout_node_offset (GtkLayoutNode *node,
+			gint           dx,
+			gint           dy)
+{
+  GtkLayoutNode *child;
+
+  node->x += dx;
+  node->y += dy;
+  for (child = node->children; child; child = child->next)
+    gtk_layout_node_offset (child, dx, dy);
+}
+
+static void
+gtk_layout_engine_measure_children (GtkLayoutParallelWorker *worker)
+{
+  GtkLayoutParallelMeasure *measure = worker->measure;
+  gint i, end;
+
+  for (;;)
+    {
+      i = g_atomic_int_exchange_and_add (&measure->next, PARALLEL_CHUNK);
+      if (i >= measure->n_children)
+	return;
+
+      end = MIN (i + PARALLEL_CHUNK, measure->n_children);
+      for (; i < end; i++)
+	gtk_layout_engine_allocate_node (worker->engine, measure->children[i],
+					 0, 0, measure->width);
+    }
+}
+
+/* Runs in the threads of the pool, each time with another helper.  */
+static void
+gtk_layout_engine_run_helper (gpointer data,
+			      gpointer user_data)
+{
+  GtkLayoutParallelWorker *worker = data;
+  GtkLayoutEngine *owner = worker->owner;
+
+  gtk_layout_engine_measure_children (worker);
+
+  g_mutex_lock (owner->mutex);
+  if (--owner->n_running == 0)
+    g_cond_signal (owner->cond);
+  g_mutex_unlock (owner->mutex);
+}
+
+/* The height of a child of a vertical box only depends on the width
+   of the box, so the children can be laid out at (0, 0) in any order,
+   and moved in place afterwards.  Nested boxes are measured by the
+   thread that got them.  */
+static gboolean
+gtk_layout_engine_measure_parallel (GtkLayoutEngine *engine,
+				    GtkLayoutNode   *node,
+				    gint             width)
+{
+  GtkLayoutParallelMeasure measure;
+  GtkLayoutParallelWorker *workers;
+  GPtrArray *children;
+  GtkLayoutNode *child;
+  guint n_threads, i;
+
+  if (engine->helpers->len == 0 || engine->parallel)
+    return FALSE;
+
+  children = g_ptr_array_new ();
+  for (child = gtk_layout_node_next_child (node, NULL); child;
+       child = gtk_layout_node_next_child (node, child))
+    g_ptr_array_add (children, child);
+
+  if (children->len < PARALLEL_MIN_CHILDREN)
+    {
+      g_ptr_array_free (children, TRUE);
+      return FALSE;
+    }
+
+  /* An exclusive pool runs each helper in a thread of its own.  If no
+     thread can be created, this thread does all the work.  */
+  if (!engine->mutex)
+    {
+      engine->mutex = g_mutex_new ();
+      engine->cond = g_cond_new ();
+    }
+  if (!engine->pool)
+    {
+      engine->pool = g_thread_pool_new (gtk_layout_engine_run_helper, NULL,
+					engine->helpers->len, TRUE, NULL);
+      if (engine->pool && g_thread_pool_get_num_threads (engine->pool) == 0)
+	{
+	  g_thread_pool_free (engine->pool, TRUE, FALSE);
+	  engine->pool = NULL;
+	}
+    }
+
+  measure.children = (GtkLayoutNode **) children->pdata;
+  measure.n_children = children->len;
+  measure.width = width;
+  measure.next = 0;
+
+  n_threads = engine->helpers->len + 1;
+  workers = g_new (GtkLayoutParallelWorker, n_threads);
+  for (i = 0; i < n_threads; i++)
+    {
+      workers[i].engine = i ? g_ptr_array_index (engine->helpers, i - 1) : engine;
+      workers[i].measure = &measure;
+      workers[i].owner = engine;
+    }
+
+  /* This thread takes part too.  */
+  engine->parallel = TRUE;
+  engine->n_running = n_threads - 1;
+  if (engine->pool)
+    for (i = 1; i < n_threads; i++)
+      g_thread_pool_push (engine->pool, &workers[i], NULL);
+  else
+    engine->n_running = 0;
+
+  gtk_layout_engine_measure_children (&workers[0]);
+
+  g_mutex_lock (engine->mutex);
+  while (engine->n_running > 0)
+    g_cond_wait (engine->cond, engine->mutex);
+  g_mutex_unlock (engine->mutex);
+  engine->parallel = FALSE;
+
+  g_free (workers);
+  g_ptr_array_free (children, TRUE);
+  return TRUE;
+}
+
+static void
+gtk_layout_engine_allocate_vbox (GtkLayoutEngine *engine,
+				 GtkLayoutNode   *node)
+{
+  GtkLayoutNode *child;
+  gboolean measured;
+  gint available_width;
+  gint y;
+
+  available_width = node->width - 2 * node->border_width;
+  measured = gtk_layout_engine_measure_parallel (engine, node, available_width);
+
+  y = node->y + node->border_width;
+  for (child = gtk_layout_node_next_child (node, NULL); child;
+       child = gtk_layout_node_next_child (node, child))
+    {
+      if (measured)
+	gtk_layout_node_offset (child, node->x + node->border_width,
+				y + child->padding);
+      else
+	gtk_layout_engine_allocate_node (engine, child,
+					 node->x + node->border_width,
+					 y + child->padding, available_width);
+
+      node->width = MAX (node->width, child->width);
+      y += child->height + child->padding * 2 + node->spacing;
+    }
+
+  if (y > node->y + node->border_width)
+    y -= node->spacing;
+  node->height = y + node->border_width - node->y;
+}
+
+static void
+gtk_layout_engine_allocate_hbox (GtkLayoutEngine *engine,
+				 GtkLayoutNode   *node)
+{
+  GtkLayoutNode *child;
+  gint row_height, row_width;
+  gint available_width;
+
+  row_height = 0;
+  row_width = node->border_width;
+  available_width = node->width - node->border_width;
+
+  node->width = node->height = 0;
+  for (child = gtk_layout_node_next_child (node, NULL); child;
+       child = gtk_layout_node_next_child (node, child))
+    {
+      if (row_width + child->request_width > available_width)
+	{
+	  node->width = MAX (node->width, row_width + node->border_width);
+	  node->height += row_height + node->spacing;
+	  row_width = node->border_width;
+	  row_height = 0;
+	}
+
+      gtk_layout_engine_allocate_node (engine, child,
+				       node->x + row_width + child->padding,
+				       node->y + node->height, available_width);
+
+      row_width += child->width + node->spacing + child->padding * 2;
+      row_height = MAX (row_height, child->height);
+    }
+
+  node->width = MAX (node->width, row_width + node->border_width);
+  if (row_height == 0)
+    node->height += node->border_width - node->spacing;
+  else
+    node->height += row_height + node->border_width;
+}
+
+static void
+gtk_layout_engine_allocate_node (GtkLayoutEngine *engine,
+				 GtkLayoutNode   *node,
+				 gint             x,
+				 gint             y,
+				 gint             width)
+{
+  node->x = x;
+  node->y = y;
+  node->width = width;
+  node->height = 0;
+  node->available_width = width;
+
+  switch (node->type)
+    {
+    case GTK_LAYOUT_NODE_VBOX:
+      gtk_layout_engine_allocate_vbox (engine, node);
+      break;
+
+    case GTK_LAYOUT_NODE_HBOX:
+      gtk_layout_engine_allocate_hbox (engine, node);
+      break;
+
+    case GTK_LAYOUT_NODE_TEXT:
+      if (node->wrap)
+	{
+	  /* GtkLabel wraps at the whole width, padding included.  */
+	  (* engine->measure) (node->text, width,
+			       &node->width, &node->height,
+			       engine->user_data);
+	  node->width += node->xpad * 2;
+	  node->height += node->ypad * 2;
+	  break;
+	}
+
+      /* fall through */
+
+    case GTK_LAYOUT_NODE_FIXED:
+      node->width = node->request_width;
+      node->height = node->request_height;
+      break;
+    }
+}
+
+/**
+ * gtk_layout_engine_allocate:
+ * @engine: a #GtkLayoutEngine
+ * @node: a #GtkLayoutNode
+ * @x: the x coordinate of @node
+ * @y: the y coordinate of @node
+ * @width: the width available to @node
+ *
+ * Lays out @node and its children at the given position and width,
+ * and stores the position and size of each node in its x, y, width and
+ * height fields.  The requisitions are computed first.
+ **/
+void
+gtk_layout_engine_allocate (GtkLayoutEngine *engine,
+			    GtkLayoutNode   *node,
+			    gint             x,
+			    gint             y,
+			    gint             width)
+{
+  g_return_if_fail (engine != NULL);
+  g_return_if_fail (node != NULL);
+
+  gtk_layout_engine_request (engine, node);
+  gtk_layout_engine_allocate_node (engine, node, x, y, width);
+}
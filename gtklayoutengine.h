@@ -0,0 +1,122 @@
+/* GTK - The GIMP Toolkit
+ * Copyright (C) 2008 Free Software Foundation, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GTK_LAYOUT_ENGINE_H__
+#define __GTK_LAYOUT_ENGINE_H__
+
+#include <glib.h>
+#include <pango/pango.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+  GTK_LAYOUT_NODE_VBOX,
+  GTK_LAYOUT_NODE_HBOX,
+  GTK_LAYOUT_NODE_TEXT,
+  GTK_LAYOUT_NODE_FIXED
+} GtkLayoutNodeType;
+
+typedef struct _GtkLayoutNode   GtkLayoutNode;
+typedef struct _GtkLayoutEngine GtkLayoutEngine;
+
+/* Measures TEXT.  If WIDTH is -1 the text is not wrapped, otherwise
+   it is wrapped at WIDTH pixels.  */
+typedef void (*GtkLayoutMeasureFunc) (const gchar *text,
+				      gint         width,
+				      gint        *text_width,
+				      gint        *text_height,
+				      gpointer     user_data);
+
+struct _GtkLayoutNode
+{
+  GtkLayoutNodeType type;
+
+  GtkLayoutNode *parent;
+  GtkLayoutNode *children;
+  GtkLayoutNode *last_child;
+  GtkLayoutNode *prev;
+  GtkLayoutNode *next;
+
+  guint visible : 1;
+  guint pack_end : 1;
+  guint wrap : 1;
+
+  /* Packing in the parent box.  */
+  gint padding;
+
+  /* Boxes.  */
+  gint spacing;
+  gint border_width;
+
+  /* Text nodes, like GtkMisc.  */
+  gchar *text;
+  gint xpad;
+  gint ypad;
+
+  /* The requisition, fixed for GTK_LAYOUT_NODE_FIXED.  */
+  gint request_width;
+  gint request_height;
+
+  /* Filled in by gtk_layout_engine_allocate.  The available width is
+     the one that the parent offered, the width is the one used.  */
+  gint x;
+  gint y;
+  gint width;
+  gint height;
+  gint available_width;
+
+  gpointer user_data;
+};
+
+GtkLayoutNode   *gtk_layout_node_new_vbox        (gint              spacing);
+GtkLayoutNode   *gtk_layout_node_new_hbox        (gint              spacing);
+GtkLayoutNode   *gtk_layout_node_new_text        (const gchar      *text,
+						  gboolean          wrap);
+GtkLayoutNode   *gtk_layout_node_new_fixed       (gint              width,
+						  gint              height);
+void             gtk_layout_node_append          (GtkLayoutNode    *parent,
+						  GtkLayoutNode    *child,
+						  gint              padding,
+						  gboolean          pack_end);
+void             gtk_layout_node_set_text        (GtkLayoutNode    *node,
+						  const gchar      *text);
+void             gtk_layout_node_free            (GtkLayoutNode    *node);
+
+GtkLayoutEngine *gtk_layout_engine_new           (GtkLayoutMeasureFunc func,
+						  gpointer          user_data,
+						  GDestroyNotify    notify);
+GtkLayoutEngine *gtk_layout_engine_new_for_pango (PangoContext     *context);
+GtkLayoutEngine *gtk_layout_engine_new_fake      (gint              char_width,
+						  gint              line_height);
+void             gtk_layout_engine_add_helper    (GtkLayoutEngine  *engine,
+						  GtkLayoutEngine  *helper);
+void             gtk_layout_engine_free          (GtkLayoutEngine  *engine);
+
+void             gtk_layout_engine_request       (GtkLayoutEngine  *engine,
+						  GtkLayoutNode    *node);
+void             gtk_layout_engine_allocate      (GtkLayoutEngine  *engine,
+						  GtkLayoutNode    *node,
+						  gint              x,
+						  gint              y,
+						  gint              width);
+
+G_END_DECLS
+
+#endif /* __GTK_LAYOUT_ENGINE_H__ */
@@ -0,0 +1,774 @@
+/* gtklayoutrecorder.c
+ * Copyright (C) 2008 Free Software Foundation, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* A recording starts with the tree below the GtkManagedLayout, one
+   node per widget in depth-first order, and goes on with the events
+   that changed the layout.  Everything is written as variable-length
+   integers, so that the files stay small even for long sessions:
+
+     recording := "GTKLREC1" node* END event*
+     node      := kind parent-id visible border-width packing? data
+     packing   := expand fill padding pack-type      (children of boxes)
+     event     := type delta-usec data
+
+   The parent of the first node is the GtkManagedLayout itself.  */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <gtk/gtk.h>
+#include "gtklayoutrecorder.h"
+#include "gtkellipsis.h"
+#include "gtkresizer.h"
+
+#define I_(x)		(x)
+
+#define RECORDING_MAGIC "GTKLREC1"
+
+typedef enum
+{
+  NODE_END,
+  NODE_VBOX,
+  NODE_HBOX,
+  NODE_LABEL,
+  NODE_ELLIPSIS,
+  NODE_RESIZER,
+  NODE_BIN,
+  NODE_OTHER
+} NodeKind;
+
+struct _GtkLayoutRecorder
+{
+  GtkManagedLayout *managed_layout;
+  GtkAdjustment *vadjustment;
+  FILE *file;
+  GTimer *timer;
+  gdouble last_time;
+
+  /* Weak pointers, indexed by node id.  */
+  guint n_widgets;
+  GtkWidget **widgets;
+};
+
+struct _GtkLayoutReplay
+{
+  GtkWidget *managed_layout;
+  gchar *contents;
+  gsize length;
+  gsize pos;
+
+  guint n_widgets;
+  GtkWidget **widgets;
+};
+
+static GQuark quark_recorder_id;
+
+
+/* Encoding.  */
+
+static void
+write_uint (FILE *file, guint value)
+{
+  while (value >= 0x80)
+    {
+      putc ((value & 0x7f) | 0x80, file);
+      value >>= 7;
+    }
+  putc (value, file);
+}
+
+static void
+write_int (FILE *file, gint value)
+{
+  write_uint (file, value < 0 ? ((guint) ~value << 1) | 1 : (guint) value << 1);
+}
+
+static void
+write_string (FILE *file, const gchar *str)
+{
+  gsize length;
+
+  length = str ? strlen (str) : 0;
+  write_uint (file, length);
+  fwrite (str, 1, length, file);
+}
+
+static gboolean
+read_uint (GtkLayoutReplay *replay, guint *value)
+{
+  guint shift;
+  guchar c;
+
+  *value = 0;
+  for (shift = 0; shift < 32; shift += 7)
+    {
+      if (replay->pos >= replay->length)
+	return FALSE;
+
+      c = replay->contents[replay->pos++];
+      *value |= (guint) (c & 0x7f) << shift;
+      if (!(c & 0x80))
+	return TRUE;
+    }
+
+  return FALSE;
+}
+
+static gboolean
+read_int (GtkLayoutReplay *replay, gint *value)
+{
+  guint u;
+
+  if (!read_uint (replay, &u))
+    return FALSE;
+
+  *value = (u & 1) ? ~(gint) (u >> 1) : (gint) (u >> 1);
+  return TRUE;
+}
+
+/* Returns a newly allocated string.  */
+static gboolean
+read_string (GtkLayoutReplay *replay, gchar **str)
+{
+  guint length;
+
+  if (!read_uint (replay, &length)
+      || length > replay->length - replay->pos)
+    return FALSE;
+
+  *str = g_strndup (replay->contents + replay->pos, length);
+  replay->pos += length;
+  return TRUE;
+}
+
+
+/* Recording.  */
+
+static gint
+gtk_layout_recorder_get_id (GtkWidget *widget)
+{
+  return GPOINTER_TO_INT (g_object_get_qdata (G_OBJECT (widget),
+					      quark_recorder_id)) - 1;
+}
+
+static void
+gtk_layout_recorder_begin_event (GtkLayoutRecorder  *recorder,
+				 GtkLayoutEventType  type)
+{
+  gdouble time;
+
+  time = g_timer_elapsed (recorder->timer, NULL);
+  write_uint (recorder->file, type);
+  write_uint (recorder->file, (time - recorder->last_time) * 1e6);
+  recorder->last_time = time;
+}
+
+static void
+gtk_layout_recorder_size_allocate (GtkWidget         *widget,
+				   GtkAllocation     *allocation,
+				   GtkLayoutRecorder *recorder)
+{
+  gtk_layout_recorder_begin_event (recorder, GTK_LAYOUT_EVENT_ALLOCATE);
+  write_uint (recorder->file, allocation->width);
+  write_uint (recorder->file, allocation->height);
+}
+
+static void
+gtk_layout_recorder_value_changed (GtkAdjustment     *adjustment,
+				   GtkLayoutRecorder *recorder)
+{
+  gtk_layout_recorder_begin_event (recorder, GTK_LAYOUT_EVENT_SCROLL);
+  write_uint (recorder->file, (guint) adjustment->value);
+}
+
+static void
+gtk_layout_recorder_notify (GObject           *object,
+			    GParamSpec        *pspec,
+			    GtkLayoutRecorder *recorder)
+{
+  GtkWidget *widget = GTK_WIDGET (object);
+  gboolean size_set;
+  gint id;
+
+  id = gtk_layout_recorder_get_id (widget);
+  if (GTK_IS_LABEL (widget) && !strcmp (pspec->name, "label"))
+    {
+      gtk_layout_recorder_begin_event (recorder, GTK_LAYOUT_EVENT_LABEL_TEXT);
+      write_uint (recorder->file, id);
+      write_string (recorder->file, gtk_label_get_label (GTK_LABEL (widget)));
+    }
+  else if (GTK_IS_ELLIPSIS (widget) && !strcmp (pspec->name, "expanded"))
+    {
+      gtk_layout_recorder_begin_event (recorder,
+				       GTK_LAYOUT_EVENT_ELLIPSIS_EXPANDED);
+      write_uint (recorder->file, id);
+      write_uint (recorder->file,
+		  gtk_ellipsis_get_expanded (GTK_ELLIPSIS (widget)));
+    }
+  else if (GTK_IS_RESIZER (widget) && !strcmp (pspec->name, "size"))
+    {
+      g_object_get (widget, "size-set", &size_set, NULL);
+      gtk_layout_recorder_begin_event (recorder,
+				       GTK_LAYOUT_EVENT_RESIZER_SIZE);
+      write_uint (recorder->file, id);
+      write_int (recorder->file,
+		 size_set ? gtk_resizer_get_size (GTK_RESIZER (widget)) : -1);
+    }
+}
+
+static void
+gtk_layout_recorder_write_node (GtkLayoutRecorder *recorder,
+				GtkWidget         *widget,
+				gint               parent_id)
+{
+  FILE *file = recorder->file;
+  GtkWidget *parent;
+  GtkRequisition requisition;
+  GtkPackType pack_type;
+  gboolean expand, fill, size_set;
+  guint padding;
+  NodeKind kind;
+
+  /* Subclasses are recorded like the nearest class we know.  */
+  if (GTK_IS_VBOX (widget))
+    kind = NODE_VBOX;
+  else if (GTK_IS_HBOX (widget))
+    kind = NODE_HBOX;
+  else if (GTK_IS_LABEL (widget))
+    kind = NODE_LABEL;
+  else if (GTK_IS_ELLIPSIS (widget))
+    kind = NODE_ELLIPSIS;
+  else if (GTK_IS_RESIZER (widget))
+    kind = NODE_RESIZER;
+  else if (GTK_IS_BIN (widget))
+    kind = NODE_BIN;
+  else
+    kind = NODE_OTHER;
+
+  write_uint (file, kind);
+  write_int (file, parent_id);
+  write_uint (file, GTK_WIDGET_VISIBLE (widget));
+  write_uint (file, GTK_IS_CONTAINER (widget)
+		    ? GTK_CONTAINER (widget)->border_width : 0);
+
+  parent = widget->parent;
+  if (GTK_IS_BOX (parent))
+    {
+      gtk_box_query_child_packing (GTK_BOX (parent), widget,
+				   &expand, &fill, &padding, &pack_type);
+      write_uint (file, expand);
+      write_uint (file, fill);
+      write_uint (file, padding);
+      write_uint (file, pack_type);
+    }
+
+  switch (kind)
+    {
+    case NODE_VBOX:
+    case NODE_HBOX:
+      write_uint (file, gtk_box_get_homogeneous (GTK_BOX (widget)));
+      write_uint (file, gtk_box_get_spacing (GTK_BOX (widget)));
+      break;
+
+    case NODE_LABEL:
+      write_string (file, gtk_label_get_label (GTK_LABEL (widget)));
+      write_uint (file, gtk_label_get_use_markup (GTK_LABEL (widget)));
+      write_uint (file, gtk_label_get_line_wrap (GTK_LABEL (widget)));
+      break;
+
+    case NODE_ELLIPSIS:
+      write_string (file, gtk_ellipsis_get_label (GTK_ELLIPSIS (widget)));
+      write_uint (file, gtk_ellipsis_get_expanded (GTK_ELLIPSIS (widget)));
+      break;
+
+    case NODE_RESIZER:
+      g_object_get (widget, "size-set", &size_set, NULL);
+      write_int (file,
+		 size_set ? gtk_resizer_get_size (GTK_RESIZER (widget)) : -1);
+      break;
+
+    case NODE_OTHER:
+      /* Replaced by a widget of the same size.  */
+      gtk_widget_size_request (widget, &requisition);
+      write_uint (file, requisition.width);
+      write_uint (file, requisition.height);
+      break;
+
+    default:
+      break;
+    }
+}
+
+static void
+gtk_layout_recorder_add_widget (GtkWidget *widget,
+				gpointer   data)
+{
+  GPtrArray *widgets = data;
+
+  g_object_set_qdata (G_OBJECT (widget), quark_recorder_id,
+		      GINT_TO_POINTER (widgets->len + 1));
+  g_ptr_array_add (widgets, widget);
+
+  /* The children of unknown widgets are not recorded, and neither
+     are label widgets such as the one in GtkEllipsis.  */
+  if (GTK_IS_BOX (widget))
+    gtk_container_foreach (GTK_CONTAINER (widget),
+			   gtk_layout_recorder_add_widget, widgets);
+  else if (GTK_IS_BIN (widget) && GTK_BIN (widget)->child)
+    gtk_layout_recorder_add_widget (GTK_BIN (widget)->child, widgets);
+}
+
+/**
+ * gtk_layout_recorder_new:
+ * @managed_layout: a #GtkManagedLayout
+ * @filename: the file to write
+ * @error: return location for an error, or %NULL
+ *
+ * Writes the tree of widgets in @managed_layout to @filename, and then
+ * records the changes to its allocation and scroll position, the text
+ * of its labels, the state of its ellipses and the size of its
+ * resizers until gtk_layout_recorder_free() is called.  Widgets that
+ * are added to the tree while recording are not part of the recording.
+ *
+ * Return value: a new #GtkLayoutRecorder, or %NULL if the file could
+ * not be created
+ **/
+GtkLayoutRecorder *
+gtk_layout_recorder_new (GtkManagedLayout  *managed_layout,
+			 const gchar       *filename,
+			 GError           **error)
+{
+  GtkLayoutRecorder *recorder;
+  GPtrArray *widgets;
+  GtkWidget *widget;
+  guint i;
+
+  g_return_val_if_fail (GTK_IS_MANAGED_LAYOUT (managed_layout), NULL);
+  g_return_val_if_fail (filename != NULL, NULL);
+
+  if (!quark_recorder_id)
+    quark_recorder_id = g_quark_from_static_string (I_("gtk-layout-recorder-id"));
+
+  recorder = g_new0 (GtkLayoutRecorder, 1);
+  recorder->file = fopen (filename, "wb");
+  if (!recorder->file)
+    {
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+		   "cannot create %s", filename);
+      g_free (recorder);
+      return NULL;
+    }
+
+  recorder->managed_layout = managed_layout;
+  g_object_add_weak_pointer (G_OBJECT (managed_layout),
+			     (gpointer *) &recorder->managed_layout);
+
+  /* The managed layout is the parent of the first node, with id -1.  */
+  g_object_set_qdata (G_OBJECT (managed_layout), quark_recorder_id, NULL);
+  widgets = g_ptr_array_new ();
+  if (GTK_BIN (managed_layout)->child)
+    gtk_layout_recorder_add_widget (GTK_BIN (managed_layout)->child, widgets);
+
+  recorder->n_widgets = widgets->len;
+  recorder->widgets = (GtkWidget **) g_ptr_array_free (widgets, FALSE);
+
+  fputs (RECORDING_MAGIC, recorder->file);
+  for (i = 0; i < recorder->n_widgets; i++)
+    {
+      widget = recorder->widgets[i];
+      gtk_layout_recorder_write_node (recorder, widget,
+				      gtk_layout_recorder_get_id (widget->parent));
+      g_object_add_weak_pointer (G_OBJECT (widget),
+				 (gpointer *) &recorder->widgets[i]);
+      if (GTK_IS_LABEL (widget) || GTK_IS_ELLIPSIS (widget)
+	  || GTK_IS_RESIZER (widget))
+	g_signal_connect (widget, "notify",
+			  G_CALLBACK (gtk_layout_recorder_notify), recorder);
+    }
+
+  write_uint (recorder->file, NODE_END);
+
+  recorder->timer = g_timer_new ();
+  g_signal_connect_after (managed_layout, "size-allocate",
+			  G_CALLBACK (gtk_layout_recorder_size_allocate),
+			  recorder);
+
+  recorder->vadjustment = gtk_managed_layout_get_vadjustment (managed_layout);
+  g_object_ref (recorder->vadjustment);
+  g_signal_connect (recorder->vadjustment, "value-changed",
+		    G_CALLBACK (gtk_layout_recorder_value_changed), recorder);
+
+  return recorder;
+}
+
+/**
+ * gtk_layout_recorder_free:
+ * @recorder: a #GtkLayoutRecorder
+ *
+ * Stops recording and closes the file.
+ **/
+void
+gtk_layout_recorder_free (GtkLayoutRecorder *recorder)
+{
+  guint i;
+
+  g_return_if_fail (recorder != NULL);
+
+  for (i = 0; i < recorder->n_widgets; i++)
+    if (recorder->widgets[i])
+      {
+	g_signal_handlers_disconnect_by_func (recorder->widgets[i],
+					      gtk_layout_recorder_notify,
+					      recorder);
+	g_object_remove_weak_pointer (G_OBJECT (recorder->widgets[i]),
+				      (gpointer *) &recorder->widgets[i]);
+      }
+
+  if (recorder->managed_layout)
+    {
+      g_signal_handlers_disconnect_by_func (recorder->managed_layout,
+					    gtk_layout_recorder_size_allocate,
+					    recorder);
+      g_object_remove_weak_pointer (G_OBJECT (recorder->managed_layout),
+				    (gpointer *) &recorder->managed_layout);
+    }
+
+  g_signal_handlers_disconnect_by_func (recorder->vadjustment,
+					gtk_layout_recorder_value_changed,
+					recorder);
+  g_object_unref (recorder->vadjustment);
+
+  fclose (recorder->file);
+  g_timer_destroy (recorder->timer);
+  g_free (recorder->widgets);
+  g_free (recorder);
+}
+
+
+/* Replay.  */
+
+static gboolean
+gtk_layout_replay_read_node (GtkLayoutReplay *replay,
+			     NodeKind         kind,
+			     GPtrArray       *widgets)
+{
+  GtkWidget *widget, *parent;
+  gint parent_id;
+  guint visible, border_width;
+  guint expand, fill, padding, pack_type;
+  guint homogeneous, spacing, use_markup, wrap, expanded, width, height;
+  gint size;
+  gchar *text;
+
+  if (!read_int (replay, &parent_id)
+      || parent_id < -1 || parent_id >= (gint) widgets->len
+      || !read_uint (replay, &visible)
+      || !read_uint (replay, &border_width))
+    return FALSE;
+
+  parent = (parent_id == -1)
+    ? replay->managed_layout : g_ptr_array_index (widgets, parent_id);
+  if (!GTK_IS_CONTAINER (parent)
+      || (GTK_IS_BIN (parent) && GTK_BIN (parent)->child))
+    return FALSE;
+
+  if (GTK_IS_BOX (parent)
+      && (!read_uint (replay, &expand)
+	  || !read_uint (replay, &fill)
+	  || !read_uint (replay, &padding)
+	  || !read_uint (replay, &pack_type)))
+    return FALSE;
+
+  switch (kind)
+    {
+    case NODE_VBOX:
+    case NODE_HBOX:
+      if (!read_uint (replay, &homogeneous)
+	  || !read_uint (replay, &spacing))
+	return FALSE;
+      widget = (kind == NODE_VBOX)
+	? gtk_vbox_new (homogeneous, spacing)
+	: gtk_hbox_new (homogeneous, spacing);
+      break;
+
+    case NODE_LABEL:
+      if (!read_string (replay, &text))
+	return FALSE;
+      if (!read_uint (replay, &use_markup)
+	  || !read_uint (replay, &wrap))
+	{
+	  g_free (text);
+	  return FALSE;
+	}
+      widget = gtk_label_new (NULL);
+      gtk_label_set_use_markup (GTK_LABEL (widget), use_markup);
+      gtk_label_set_label (GTK_LABEL (widget), text);
+      gtk_label_set_line_wrap (GTK_LABEL (widget), wrap);
+      g_free (text);
+      break;
+
+    case NODE_ELLIPSIS:
+      if (!read_string (replay, &text))
+	return FALSE;
+      if (!read_uint (replay, &expanded))
+	{
+	  g_free (text);
+	  return FALSE;
+	}
+      widget = gtk_ellipsis_new (text);
+      gtk_ellipsis_set_expanded (GTK_ELLIPSIS (widget), expanded);
+      g_free (text);
+      break;
+
+    case NODE_RESIZER:
+      if (!read_int (replay, &size))
+	return FALSE;
+      widget = gtk_resizer_new ();
+      gtk_resizer_set_size (GTK_RESIZER (widget), size);
+      break;
+
+    case NODE_BIN:
+      widget = gtk_event_box_new ();
+      gtk_event_box_set_visible_window (GTK_EVENT_BOX (widget), FALSE);
+      break;
+
+    case NODE_OTHER:
+      if (!read_uint (replay, &width)
+	  || !read_uint (replay, &height))
+	return FALSE;
+      widget = gtk_drawing_area_new ();
+      gtk_widget_set_size_request (widget, width, height);
+      break;
+
+    default:
+      return FALSE;
+    }
+
+  if (GTK_IS_CONTAINER (widget))
+    gtk_container_set_border_width (GTK_CONTAINER (widget), border_width);
+  if (visible)
+    gtk_widget_show (widget);
+
+  if (GTK_IS_BOX (parent))
+    {
+      if (pack_type == GTK_PACK_END)
+	gtk_box_pack_end (GTK_BOX (parent), widget, expand, fill, padding);
+      else
+	gtk_box_pack_start (GTK_BOX (parent), widget, expand, fill, padding);
+    }
+  else
+    gtk_container_add (GTK_CONTAINER (parent), widget);
+
+  g_ptr_array_add (widgets, widget);
+  return TRUE;
+}
+
+/**
+ * gtk_layout_replay_new:
+ * @filename: a file written by a #GtkLayoutRecorder
+ * @error: return location for an error, or %NULL
+ *
+ * Reads a recording and rebuilds the tree of widgets in it, inside a
+ * new #GtkManagedLayout.  The events are then applied one at a time
+ * with gtk_layout_replay_step().
+ *
+ * Return value: a new #GtkLayoutReplay, or %NULL on error
+ **/
+GtkLayoutReplay *
+gtk_layout_replay_new (const gchar  *filename,
+		       GError      **error)
+{
+  GtkLayoutReplay *replay;
+  GPtrArray *widgets;
+  gboolean ended;
+  guint kind;
+
+  g_return_val_if_fail (filename != NULL, NULL);
+
+  replay = g_new0 (GtkLayoutReplay, 1);
+  if (!g_file_get_contents (filename, &replay->contents, &replay->length,
+			    error))
+    {
+      g_free (replay);
+      return NULL;
+    }
+
+  if (replay->length < strlen (RECORDING_MAGIC)
+      || memcmp (replay->contents, RECORDING_MAGIC, strlen (RECORDING_MAGIC)))
+    goto error;
+
+  replay->pos = strlen (RECORDING_MAGIC);
+  replay->managed_layout = gtk_managed_layout_new (NULL, NULL);
+  g_object_ref_sink (replay->managed_layout);
+
+  widgets = g_ptr_array_new ();
+  ended = FALSE;
+  while (!ended && read_uint (replay, &kind))
+    {
+      if (kind == NODE_END)
+	ended = TRUE;
+      else if (!gtk_layout_replay_read_node (replay, kind, widgets))
+	break;
+    }
+
+  replay->n_widgets = widgets->len;
+  replay->widgets = (GtkWidget **) g_ptr_array_free (widgets, FALSE);
+  if (ended)
+    return replay;
+
+error:
+  g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+	       "%s is not a valid layout recording", filename);
+  gtk_layout_replay_free (replay);
+  return NULL;
+}
+
+/**
+ * gtk_layout_replay_get_layout:
+ * @replay: a #GtkLayoutReplay
+ *
+ * Returns the #GtkManagedLayout that holds the rebuilt tree.  It has to
+ * be put in a toplevel window before the events are replayed.
+ *
+ * Return value: the #GtkManagedLayout
+ **/
+GtkWidget *
+gtk_layout_replay_get_layout (GtkLayoutReplay *replay)
+{
+  g_return_val_if_fail (replay != NULL, NULL);
+
+  return replay->managed_layout;
+}
+
+static GtkWidget *
+gtk_layout_replay_read_widget (GtkLayoutReplay *replay,
+			       GType            type)
+{
+  guint id;
+
+  if (!read_uint (replay, &id) || id >= replay->n_widgets
+      || !G_TYPE_CHECK_INSTANCE_TYPE (replay->widgets[id], type))
+    return NULL;
+
+  return replay->widgets[id];
+}
+
+/**
+ * gtk_layout_replay_step:
+ * @replay: a #GtkLayoutReplay
+ * @type: return location for the type of the event, or %NULL
+ *
+ * Applies the next event of the recording right away, regardless of
+ * when it happened in the recorded session.  Allocations are applied
+ * to the #GtkManagedLayout directly, so that the replay does not
+ * depend on the window manager.  Scrolling is also applied at once,
+ * instead of at the next frame, so that scroll events are neither
+ * merged nor charged to the events that follow them.  Other events
+ * only queue a resize, as they did when they were recorded.
+ *
+ * Return value: %FALSE if there are no more events
+ **/
+gboolean
+gtk_layout_replay_step (GtkLayoutReplay    *replay,
+			GtkLayoutEventType *type)
+{
+  GtkRequisition requisition;
+  GtkAllocation allocation;
+  GtkAdjustment *adjustment;
+  GtkWidget *widget;
+  guint event_type, delta, width, height, value, expanded;
+  gint size;
+  gchar *text;
+
+  g_return_val_if_fail (replay != NULL, FALSE);
+
+  if (!read_uint (replay, &event_type)
+      || !read_uint (replay, &delta))
+    return FALSE;
+
+  switch (event_type)
+    {
+    case GTK_LAYOUT_EVENT_ALLOCATE:
+      if (!read_uint (replay, &width) || !read_uint (replay, &height))
+	return FALSE;
+      allocation = replay->managed_layout->allocation;
+      allocation.width = width;
+      allocation.height = height;
+      gtk_widget_size_request (replay->managed_layout, &requisition);
+      gtk_widget_size_allocate (replay->managed_layout, &allocation);
+      break;
+
+    case GTK_LAYOUT_EVENT_SCROLL:
+      if (!read_uint (replay, &value))
+	return FALSE;
+      adjustment = gtk_managed_layout_get_vadjustment
+	(GTK_MANAGED_LAYOUT (replay->managed_layout));
+      gtk_adjustment_set_value (adjustment, value);
+      _gtk_managed_layout_flush_scroll (GTK_MANAGED_LAYOUT (replay->managed_layout));
+      break;
+
+    case GTK_LAYOUT_EVENT_LABEL_TEXT:
+      widget = gtk_layout_replay_read_widget (replay, GTK_TYPE_LABEL);
+      if (!widget || !read_string (replay, &text))
+	return FALSE;
+      gtk_label_set_label (GTK_LABEL (widget), text);
+      g_free (text);
+      break;
+
+    case GTK_LAYOUT_EVENT_ELLIPSIS_EXPANDED:
+      widget = gtk_layout_replay_read_widget (replay, GTK_TYPE_ELLIPSIS);
+      if (!widget || !read_uint (replay, &expanded))
+	return FALSE;
+      gtk_ellipsis_set_expanded (GTK_ELLIPSIS (widget), expanded);
+      break;
+
+    case GTK_LAYOUT_EVENT_RESIZER_SIZE:
+      widget = gtk_layout_replay_read_widget (replay, GTK_TYPE_RESIZER);
+      if (!widget || !read_int (replay, &size))
+	return FALSE;
+      gtk_resizer_set_size (GTK_RESIZER (widget), size);
+      break;
+
+    default:
+      return FALSE;
+    }
+
+  if (type)
+    *type = event_type;
+  return TRUE;
+}
+
+/**
+ * gtk_layout_replay_free:
+ * @replay: a #GtkLayoutReplay
+ *
+ * Frees the replay, and drops its reference to the #GtkManagedLayout.
+ **/
+void
+gtk_layout_replay_free (GtkLayoutReplay *replay)
+{
+  g_return_if_fail (replay != NULL);
+
+  if (replay->managed_layout)
+    g_object_unref (replay->managed_layout);
+
+  g_free (replay->widgets);
+  g_free (replay->contents);
+  g_free (replay);
+}
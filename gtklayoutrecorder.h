@@ -0,0 +1,56 @@
+/* GTK - The GIMP Toolkit
+ * Copyright (C) 2008 Free Software Foundation, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GTK_LAYOUT_RECORDER_H__
+#define __GTK_LAYOUT_RECORDER_H__
+
+#include <glib.h>
+#include <gtk/gtk.h>
+#include "gtkmanagedlayout.h"
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+  GTK_LAYOUT_EVENT_ALLOCATE,
+  GTK_LAYOUT_EVENT_SCROLL,
+  GTK_LAYOUT_EVENT_LABEL_TEXT,
+  GTK_LAYOUT_EVENT_ELLIPSIS_EXPANDED,
+  GTK_LAYOUT_EVENT_RESIZER_SIZE,
+  GTK_LAYOUT_EVENT_N_TYPES
+} GtkLayoutEventType;
+
+typedef struct _GtkLayoutRecorder GtkLayoutRecorder;
+typedef struct _GtkLayoutReplay   GtkLayoutReplay;
+
+GtkLayoutRecorder *gtk_layout_recorder_new     (GtkManagedLayout    *managed_layout,
+						const gchar         *filename,
+						GError             **error);
+void               gtk_layout_recorder_free    (GtkLayoutRecorder   *recorder);
+
+GtkLayoutReplay   *gtk_layout_replay_new       (const gchar         *filename,
+						GError             **error);
+GtkWidget         *gtk_layout_replay_get_layout (GtkLayoutReplay    *replay);
+gboolean           gtk_layout_replay_step      (GtkLayoutReplay     *replay,
+						GtkLayoutEventType  *type);
+void               gtk_layout_replay_free      (GtkLayoutReplay     *replay);
+
+G_END_DECLS
+
+#endif /* __GTK_LAYOUT_RECORDER_H__ */
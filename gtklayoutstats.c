@@ -0,0 +1,464 @@
+/* gtklayoutstats.c
+ * Copyright (C) 2008 Free Software Foundation, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <gtk/gtk.h>
+#include "gtklayoutstats.h"
+
+#define I_(x)		(x)
+
+typedef struct _GtkLayoutStatsData GtkLayoutStatsData;
+
+struct _GtkLayoutStatsData
+{
+  /* The stats are cleared lazily when the generation is old.  */
+  guint generation;
+  GtkLayoutStats stats;
+};
+
+/* -1 until the environment has been looked at.  */
+static gint		stats_enabled = -1;
+static guint		stats_generation;
+static GTimer		*stats_timer;
+static GHashTable	*stats_by_type;
+static GQuark		quark_layout_stats;
+
+/* The file passed to gtk_layout_stats_set_trace_file.  */
+static FILE		*trace_file;
+static gboolean		trace_empty;
+
+/* Flows started by _gtk_layout_stats_flow_start, that end at the next
+   allocation.  */
+typedef struct _GtkLayoutStatsFlow GtkLayoutStatsFlow;
+
+struct _GtkLayoutStatsFlow
+{
+  guint id;
+  GtkLayoutStatsPhase phase;
+};
+
+static GArray		*trace_flows;
+static guint		trace_flow_id;
+
+static const gchar *const phase_names[GTK_LAYOUT_STATS_N_PHASES] = {
+  "size-request",
+  "size-allocate",
+  "pango-layout",
+  "expose",
+  "scroll",
+  "resizer-drag",
+  "ellipsis-expand"
+};
+
+static void
+gtk_layout_stats_start_timer (void)
+{
+  if (!stats_timer)
+    {
+      stats_timer = g_timer_new ();
+      stats_by_type = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+    }
+}
+
+static void
+gtk_layout_stats_check_env (void)
+{
+  const gchar *filename;
+
+  if (stats_enabled != -1)
+    return;
+
+  gtk_layout_stats_set_enabled (g_getenv ("GTK_LAYOUT_STATS") != NULL);
+  filename = g_getenv ("GTK_LAYOUT_TRACE");
+  if (filename && !trace_file)
+    gtk_layout_stats_set_trace_file (filename);
+}
+
+static void
+gtk_layout_stats_write_string (const gchar *str)
+{
+  const gchar *p;
+
+  putc ('"', trace_file);
+  for (p = str; *p; p++)
+    {
+      if (*p == '"' || *p == '\\')
+	fprintf (trace_file, "\\%c", *p);
+      else if ((guchar) *p < 0x20)
+	fprintf (trace_file, "\\u%04x", (guchar) *p);
+      else
+	putc (*p, trace_file);
+    }
+  putc ('"', trace_file);
+}
+
+/* Write a begin or end event in the Trace Event Format.  */
+static void
+gtk_layout_stats_trace (GtkWidget           *widget,
+			GtkLayoutStatsPhase  phase,
+			gchar                ph,
+			gdouble              time)
+{
+  fprintf (trace_file,
+	   "%s{\"name\": \"%s\", \"cat\": \"layout\", \"ph\": \"%c\", "
+	   "\"ts\": %.3f, \"pid\": %d, \"tid\": 1",
+	   trace_empty ? "" : ",\n", phase_names[phase], ph,
+	   time * 1e6, (int) getpid ());
+  trace_empty = FALSE;
+
+  if (ph == 'B')
+    {
+      fputs (", \"args\": {\"type\": ", trace_file);
+      gtk_layout_stats_write_string (G_OBJECT_TYPE_NAME (widget));
+      fputs (", \"name\": ", trace_file);
+      gtk_layout_stats_write_string (gtk_widget_get_name (widget));
+      fprintf (trace_file, ", \"widget\": \"%p\"}", (void *) widget);
+    }
+
+  putc ('}', trace_file);
+}
+
+/* Write a flow event.  The start of a flow is bound to the slice
+   that is open, and so is its end because of "bp": "e".  */
+static void
+gtk_layout_stats_trace_flow (GtkLayoutStatsFlow *flow,
+			     gchar               ph,
+			     gdouble             time)
+{
+  fprintf (trace_file,
+	   "%s{\"name\": \"%s\", \"cat\": \"layout\", \"ph\": \"%c\", "
+	   "\"id\": %u, \"ts\": %.3f, \"pid\": %d, \"tid\": 1%s}",
+	   trace_empty ? "" : ",\n", phase_names[flow->phase], ph, flow->id,
+	   time * 1e6, (int) getpid (), ph == 'f' ? ", \"bp\": \"e\"" : "");
+  trace_empty = FALSE;
+}
+
+static void
+gtk_layout_stats_add (GtkLayoutStats      *stats,
+		      GtkLayoutStatsPhase  phase,
+		      gdouble              time)
+{
+  stats->calls[phase]++;
+  stats->time[phase] += time;
+}
+
+static GtkLayoutStatsData *
+gtk_layout_stats_get_data (GtkWidget *widget,
+			   gboolean   create)
+{
+  GtkLayoutStatsData *data;
+
+  if (!quark_layout_stats)
+    quark_layout_stats = g_quark_from_static_string (I_("gtk-layout-stats"));
+
+  data = g_object_get_qdata (G_OBJECT (widget), quark_layout_stats);
+  if (!data && create)
+    {
+      data = g_new0 (GtkLayoutStatsData, 1);
+      data->generation = stats_generation;
+      g_object_set_qdata_full (G_OBJECT (widget), quark_layout_stats,
+			       data, g_free);
+    }
+
+  if (data && data->generation != stats_generation)
+    {
+      memset (&data->stats, 0, sizeof (data->stats));
+      data->generation = stats_generation;
+    }
+
+  return data;
+}
+
+/**
+ * gtk_layout_stats_set_enabled:
+ * @enabled: whether to collect statistics
+ *
+ * Starts or stops counting the calls to the layout functions, and the
+ * time spent in them, for each widget and for each widget type.
+ * Collection is also enabled if the %GTK_LAYOUT_STATS environment
+ * variable is set when the first widget is laid out.
+ **/
+void
+gtk_layout_stats_set_enabled (gboolean enabled)
+{
+  stats_enabled = (enabled != FALSE);
+  if (stats_enabled)
+    gtk_layout_stats_start_timer ();
+}
+
+/**
+ * gtk_layout_stats_get_enabled:
+ *
+ * Returns whether statistics are being collected.
+ *
+ * Return value: %TRUE if statistics are collected
+ **/
+gboolean
+gtk_layout_stats_get_enabled (void)
+{
+  gtk_layout_stats_check_env ();
+  return stats_enabled;
+}
+
+/**
+ * gtk_layout_stats_reset:
+ *
+ * Clears the statistics collected so far.
+ **/
+void
+gtk_layout_stats_reset (void)
+{
+  stats_generation++;
+  if (stats_by_type)
+    g_hash_table_remove_all (stats_by_type);
+}
+
+/**
+ * gtk_layout_stats_get_for_type:
+ * @type: a widget type
+ * @stats: a #GtkLayoutStats to fill in
+ *
+ * Fills in @stats with the statistics for the widgets whose type is
+ * exactly @type.
+ *
+ * Return value: %TRUE if any widget of type @type was laid out
+ **/
+gboolean
+gtk_layout_stats_get_for_type (GType           type,
+			       GtkLayoutStats *stats)
+{
+  GtkLayoutStats *type_stats;
+
+  g_return_val_if_fail (stats != NULL, FALSE);
+
+  type_stats = stats_by_type
+    ? g_hash_table_lookup (stats_by_type, GSIZE_TO_POINTER (type)) : NULL;
+  if (!type_stats)
+    {
+      memset (stats, 0, sizeof (*stats));
+      return FALSE;
+    }
+
+  *stats = *type_stats;
+  return TRUE;
+}
+
+/**
+ * gtk_layout_stats_get_for_widget:
+ * @widget: a #GtkWidget
+ * @stats: a #GtkLayoutStats to fill in
+ *
+ * Fills in @stats with the statistics for @widget.  Together with the
+ * fact that the times include the children, this can be used to look
+ * for the subtree that is responsible for a slow resize.
+ *
+ * Return value: %TRUE if @widget was laid out
+ **/
+gboolean
+gtk_layout_stats_get_for_widget (GtkWidget      *widget,
+				 GtkLayoutStats *stats)
+{
+  GtkLayoutStatsData *data;
+
+  g_return_val_if_fail (GTK_IS_WIDGET (widget), FALSE);
+  g_return_val_if_fail (stats != NULL, FALSE);
+
+  data = gtk_layout_stats_get_data (widget, FALSE);
+  if (!data)
+    {
+      memset (stats, 0, sizeof (*stats));
+      return FALSE;
+    }
+
+  *stats = data->stats;
+  return TRUE;
+}
+
+typedef struct
+{
+  GtkLayoutStatsFunc func;
+  gpointer user_data;
+} ForeachData;
+
+static void
+gtk_layout_stats_foreach_helper (gpointer key,
+				 gpointer value,
+				 gpointer user_data)
+{
+  ForeachData *data = user_data;
+
+  (* data->func) ((GType) GPOINTER_TO_SIZE (key), value, data->user_data);
+}
+
+/**
+ * gtk_layout_stats_foreach_type:
+ * @func: the function to call
+ * @user_data: user data for @func
+ *
+ * Calls @func for each widget type that has statistics.
+ **/
+void
+gtk_layout_stats_foreach_type (GtkLayoutStatsFunc func,
+			       gpointer           user_data)
+{
+  ForeachData data;
+
+  g_return_if_fail (func != NULL);
+
+  if (!stats_by_type)
+    return;
+
+  data.func = func;
+  data.user_data = user_data;
+  g_hash_table_foreach (stats_by_type, gtk_layout_stats_foreach_helper, &data);
+}
+
+/**
+ * gtk_layout_stats_set_trace_file:
+ * @filename: the name of a file, or %NULL
+ *
+ * Starts writing a begin and an end event for each layout function
+ * to @filename, in the JSON format of the Chrome trace viewer.  Each
+ * slice carries the type and the name of the widget.  Scrolling in
+ * #GtkManagedLayout, dragging a #GtkResizer and expanding or
+ * collapsing a #GtkEllipsis are traced too; since they only queue a
+ * resize, a flow arrow links each of them to the allocation that lays
+ * out the result.  Tracing also starts if
+ * the %GTK_LAYOUT_TRACE environment variable is set to the name of a
+ * file when the first widget is laid out.
+ *
+ * If @filename is %NULL, the current trace file is completed and
+ * closed.  The trace viewer also accepts files that were not closed.
+ *
+ * Return value: %FALSE if @filename could not be opened
+ **/
+gboolean
+gtk_layout_stats_set_trace_file (const gchar *filename)
+{
+  if (trace_file)
+    {
+      fputs ("\n]\n", trace_file);
+      fclose (trace_file);
+      trace_file = NULL;
+      g_array_set_size (trace_flows, 0);
+    }
+
+  if (!filename)
+    return TRUE;
+
+  trace_file = fopen (filename, "w");
+  if (!trace_file)
+    return FALSE;
+
+  fputs ("[\n", trace_file);
+  trace_empty = TRUE;
+  if (!trace_flows)
+    trace_flows = g_array_new (FALSE, FALSE, sizeof (GtkLayoutStatsFlow));
+  gtk_layout_stats_start_timer ();
+  return TRUE;
+}
+
+/* Returns a negative value if neither statistics nor tracing are
+   enabled, so that the cost is just a test of the result.  */
+gdouble
+_gtk_layout_stats_begin (GtkWidget           *widget,
+			 GtkLayoutStatsPhase  phase)
+{
+  gdouble time;
+  guint i;
+
+  gtk_layout_stats_check_env ();
+  if (!stats_enabled && !trace_file)
+    return -1.0;
+
+  time = g_timer_elapsed (stats_timer, NULL);
+  if (trace_file)
+    {
+      gtk_layout_stats_trace (widget, phase, 'B', time);
+
+      /* The allocation that follows a gesture does the work that the
+	 gesture caused.  */
+      if (phase == GTK_LAYOUT_STATS_ALLOCATE && trace_flows->len > 0)
+	{
+	  for (i = 0; i < trace_flows->len; i++)
+	    gtk_layout_stats_trace_flow (&g_array_index (trace_flows,
+							 GtkLayoutStatsFlow, i),
+					 'f', time);
+	  g_array_set_size (trace_flows, 0);
+	}
+    }
+
+  return time;
+}
+
+/* Link the slice of PHASE that is open, for a gesture whose layout
+   happens later in the resize idle, to the next allocation.  */
+void
+_gtk_layout_stats_flow_start (GtkLayoutStatsPhase  phase)
+{
+  GtkLayoutStatsFlow flow;
+
+  if (!trace_file)
+    return;
+
+  flow.id = ++trace_flow_id;
+  flow.phase = phase;
+  gtk_layout_stats_trace_flow (&flow, 's', g_timer_elapsed (stats_timer, NULL));
+  g_array_append_val (trace_flows, flow);
+}
+
+void
+_gtk_layout_stats_end (GtkWidget           *widget,
+		       GtkLayoutStatsPhase  phase,
+		       gdouble              start)
+{
+  GtkLayoutStatsData *data;
+  GtkLayoutStats *type_stats;
+  GType type;
+  gdouble time;
+
+  /* Also ignore calls that started before statistics were enabled.  */
+  if (start < 0)
+    return;
+
+  time = g_timer_elapsed (stats_timer, NULL);
+  if (trace_file)
+    gtk_layout_stats_trace (widget, phase, 'E', time);
+
+  if (!stats_enabled)
+    return;
+
+  time -= start;
+
+  data = gtk_layout_stats_get_data (widget, TRUE);
+  gtk_layout_stats_add (&data->stats, phase, time);
+
+  type = G_OBJECT_TYPE (widget);
+  type_stats = g_hash_table_lookup (stats_by_type, GSIZE_TO_POINTER (type));
+  if (!type_stats)
+    {
+      type_stats = g_new0 (GtkLayoutStats, 1);
+      g_hash_table_insert (stats_by_type, GSIZE_TO_POINTER (type), type_stats);
+    }
+
+  gtk_layout_stats_add (type_stats, phase, time);
+}
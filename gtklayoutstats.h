@@ -0,0 +1,75 @@
+/* GTK - The GIMP Toolkit
+ * Copyright (C) 2008 Free Software Foundation, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GTK_LAYOUT_STATS_H__
+#define __GTK_LAYOUT_STATS_H__
+
+#include <glib.h>
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+  GTK_LAYOUT_STATS_REQUEST,
+  GTK_LAYOUT_STATS_ALLOCATE,
+  GTK_LAYOUT_STATS_PANGO_LAYOUT,
+  GTK_LAYOUT_STATS_EXPOSE,
+  GTK_LAYOUT_STATS_SCROLL,
+  GTK_LAYOUT_STATS_RESIZER_DRAG,
+  GTK_LAYOUT_STATS_ELLIPSIS_EXPAND,
+  GTK_LAYOUT_STATS_N_PHASES
+} GtkLayoutStatsPhase;
+
+typedef struct _GtkLayoutStats GtkLayoutStats;
+
+/* The times are in seconds, and include the time spent in the
+   children of the widget.  */
+struct _GtkLayoutStats
+{
+  guint   calls[GTK_LAYOUT_STATS_N_PHASES];
+  gdouble time[GTK_LAYOUT_STATS_N_PHASES];
+};
+
+typedef void (*GtkLayoutStatsFunc) (GType                 type,
+				    const GtkLayoutStats *stats,
+				    gpointer              user_data);
+
+void      gtk_layout_stats_set_enabled    (gboolean              enabled);
+gboolean  gtk_layout_stats_get_enabled    (void);
+void      gtk_layout_stats_reset          (void);
+gboolean  gtk_layout_stats_get_for_type   (GType                 type,
+					   GtkLayoutStats       *stats);
+gboolean  gtk_layout_stats_get_for_widget (GtkWidget            *widget,
+					   GtkLayoutStats       *stats);
+void      gtk_layout_stats_foreach_type   (GtkLayoutStatsFunc    func,
+					   gpointer              user_data);
+gboolean  gtk_layout_stats_set_trace_file (const gchar          *filename);
+
+/* Private.  */
+gdouble   _gtk_layout_stats_begin         (GtkWidget            *widget,
+					   GtkLayoutStatsPhase   phase);
+void      _gtk_layout_stats_end           (GtkWidget            *widget,
+					   GtkLayoutStatsPhase   phase,
+					   gdouble               start);
+void      _gtk_layout_stats_flow_start    (GtkLayoutStatsPhase   phase);
+
+G_END_DECLS
+
+#endif /* __GTK_LAYOUT_STATS_H__ */
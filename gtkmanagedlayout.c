@@ -28,12 +28,18 @@
  * GTK+ at ftp://ftp.gtk.org/pub/gtk/. 
  */
 
+#include <string.h>
+#include <unistd.h>
 #include <gdk/gdk.h>
 #include <gtk/gtk.h>
+#include <pango/pangocairo.h>
 
 #include "gtkmanagedlayout.h"
 #include "gtkmanagedlayoutmarshal.h"
 #include "gtklayoutable.h"
+#include "gtklayoutstats.h"
+#include "gtklayoutengine.h"
+#include "gtkconfigurebatch.h"
 
 #define I_(x)		(x)
 #define P_(x)		(x)
@@ -41,7 +47,48 @@
 enum {
    PROP_0,
    PROP_HADJUSTMENT,
-   PROP_VADJUSTMENT
+   PROP_VADJUSTMENT,
+   PROP_VIRTUALIZED,
+   PROP_OVERSCAN,
+   PROP_SMOOTH_SCROLLING,
+   PROP_BACKING_STORE,
+   PROP_ASYNC_LAYOUT,
+   PROP_PROGRESSIVE_BUDGET
+};
+
+typedef struct _GtkManagedLayoutTile GtkManagedLayoutTile;
+
+struct _GtkManagedLayoutTile
+{
+  guint key;
+  GdkRectangle area;
+  GdkPixmap *pixmap;
+  GList *link;
+};
+
+/* A snapshot of the child, laid out by the thread pool.  */
+typedef struct _GtkManagedLayoutJob GtkManagedLayoutJob;
+
+struct _GtkManagedLayoutJob
+{
+  GtkManagedLayout *managed_layout;
+  GtkLayoutNode *root;
+  GSList *labels;
+  PangoFontDescription *font;
+  cairo_font_options_t *font_options;
+  gdouble resolution;
+  gint width;
+  volatile gint cancelled;
+};
+
+/* The engine of the layout thread and its Pango contexts: one for
+   the engine, and one for each of its helpers.  */
+typedef struct _GtkManagedLayoutWorker GtkManagedLayoutWorker;
+
+struct _GtkManagedLayoutWorker
+{
+  GPtrArray *contexts;
+  GtkLayoutEngine *engine;
 };
 
 static void gtk_managed_layout_destroy (GtkObject *object);
@@ -77,9 +124,50 @@ static void gtk_managed_layout_adjustment_changed (GtkAdjustment  *adjustment,
 static void gtk_managed_layout_style_set          (GtkWidget      *widget,
 					   GtkStyle       *old_style);
 
-static void gtk_managed_layout_set_adjustment_upper (GtkAdjustment *adj,
-						     gdouble        upper,
-						     gboolean       always_emit_changed);
+static gboolean gtk_managed_layout_set_adjustment_upper (GtkAdjustment *adj,
+							 gdouble        upper,
+							 gboolean       always_emit_changed);
+static gint gtk_managed_layout_allocate_child (GtkManagedLayout *managed_layout);
+static gint gtk_managed_layout_allocate_area (GtkManagedLayout   *managed_layout,
+					      const GdkRectangle *area,
+					      gboolean            keep);
+static gint gtk_managed_layout_get_bin_height (GtkManagedLayout *managed_layout);
+static void gtk_managed_layout_update_size (GtkManagedLayout *managed_layout);
+static gboolean gtk_managed_layout_update_origin (GtkManagedLayout *managed_layout);
+
+static gboolean gtk_managed_layout_frame (gpointer data);
+static void gtk_managed_layout_drop_tiles (GtkManagedLayout *managed_layout);
+static void gtk_managed_layout_move_bin_window (GtkManagedLayout *managed_layout);
+static void gtk_managed_layout_damage_tiles (GtkManagedLayout *managed_layout,
+					     GdkRegion        *damage);
+static gint gtk_managed_layout_get_child_width (GtkManagedLayout *managed_layout);
+static gboolean gtk_managed_layout_start_async (GtkManagedLayout *managed_layout);
+static void gtk_managed_layout_cancel_async (GtkManagedLayout *managed_layout);
+static gboolean gtk_managed_layout_progress (gpointer data);
+static gboolean gtk_managed_layout_progress_covers (GtkManagedLayout *managed_layout);
+static gboolean gtk_managed_layout_progress_done (GtkManagedLayout *managed_layout);
+static void gtk_managed_layout_cancel_progress (GtkManagedLayout *managed_layout);
+
+/* How many viewports the bin_window is tall, at most.  */
+#define BIN_WINDOW_PAGES 3
+
+/* Scrolling is done at most once per frame, in milliseconds.  With
+   smooth scrolling, each frame covers this part of the distance.  */
+#define FRAME_INTERVAL 16
+#define SMOOTH_SCROLLING_STEP 0.3
+
+/* Size of the tiles of the backing store, and how many of them are
+   kept around.  */
+#define TILE_SIZE 256
+#define MAX_TILES 128
+
+/* Snapshots are laid out one at a time, by a single thread shared by
+   all the managed_layouts.  It measures large vertical boxes with at
+   most this many more threads, which the engine keeps around.  */
+#define ASYNC_LAYOUT_MAX_HELPERS 8
+
+static GThreadPool *async_layout_pool;
+static GtkManagedLayoutWorker *async_layout_worker;
 
 G_DEFINE_TYPE (GtkManagedLayout, gtk_managed_layout, GTK_TYPE_BIN)
 
@@ -238,6 +326,11 @@ gtk_managed_layout_finalize (GObject *object)
       managed_layout->vadjustment = NULL;
     }
 
+  gtk_managed_layout_drop_tiles (managed_layout);
+  g_hash_table_destroy (managed_layout->tiles);
+  g_queue_free (managed_layout->tile_queue);
+  gdk_region_destroy (managed_layout->uncovered);
+
   G_OBJECT_CLASS (gtk_managed_layout_parent_class)->finalize (object);
 }
 
@@ -246,6 +339,16 @@ gtk_managed_layout_destroy (GtkObject *object)
 {
   GtkManagedLayout *managed_layout = GTK_MANAGED_LAYOUT (object);
 
+  if (managed_layout->frame_timer)
+    {
+      g_source_remove (managed_layout->frame_timer);
+      managed_layout->frame_timer = 0;
+    }
+
+  gtk_managed_layout_cancel_async (managed_layout);
+  gtk_managed_layout_cancel_progress (managed_layout);
+  gtk_managed_layout_drop_tiles (managed_layout);
+
   if (managed_layout->hadjustment)
     {
       g_object_unref (managed_layout->hadjustment);
@@ -300,7 +403,491 @@ gtk_managed_layout_set_vadjustment (GtkManagedLayout     *managed_layout,
   g_object_notify (G_OBJECT (managed_layout), "vadjustment");
 }
 
-static void
+/**
+ * gtk_managed_layout_set_virtualized:
+ * @managed_layout: a #GtkManagedLayout
+ * @virtualized: whether to virtualize the child
+ *
+ * Sets whether the managed_layout allocates only the children of
+ * vertical boxes that are in the visible part of the managed_layout,
+ * plus the number of pixels given by the overscan property above and
+ * below it.  The other children are only measured once, are not
+ * mapped, and are unrealized.
+ **/
+void
+gtk_managed_layout_set_virtualized (GtkManagedLayout     *managed_layout,
+				    gboolean       virtualized)
+{
+  g_return_if_fail (GTK_IS_MANAGED_LAYOUT (managed_layout));
+
+  virtualized = virtualized != FALSE;
+  if (managed_layout->virtualized == virtualized)
+    return;
+
+  managed_layout->virtualized = virtualized;
+  gtk_widget_queue_resize (GTK_WIDGET (managed_layout));
+  g_object_notify (G_OBJECT (managed_layout), "virtualized");
+}
+
+/**
+ * gtk_managed_layout_get_virtualized:
+ * @managed_layout: a #GtkManagedLayout
+ *
+ * Returns whether the managed_layout only allocates the visible
+ * children.  See gtk_managed_layout_set_virtualized().
+ *
+ * Return value: %TRUE if the child is virtualized
+ **/
+gboolean
+gtk_managed_layout_get_virtualized (GtkManagedLayout     *managed_layout)
+{
+  g_return_val_if_fail (GTK_IS_MANAGED_LAYOUT (managed_layout), FALSE);
+
+  return managed_layout->virtualized;
+}
+
+/**
+ * gtk_managed_layout_set_overscan:
+ * @managed_layout: a #GtkManagedLayout
+ * @overscan: a number of pixels
+ *
+ * Sets how many pixels above and below the visible part of a
+ * virtualized managed_layout are allocated.  Scrolling within this
+ * margin does not need to lay out the child again.
+ **/
+void
+gtk_managed_layout_set_overscan (GtkManagedLayout     *managed_layout,
+				 gint           overscan)
+{
+  g_return_if_fail (GTK_IS_MANAGED_LAYOUT (managed_layout));
+  g_return_if_fail (overscan >= 0);
+
+  if (managed_layout->overscan == overscan)
+    return;
+
+  managed_layout->overscan = overscan;
+  if (managed_layout->virtualized)
+    gtk_widget_queue_resize (GTK_WIDGET (managed_layout));
+  g_object_notify (G_OBJECT (managed_layout), "overscan");
+}
+
+/**
+ * gtk_managed_layout_get_overscan:
+ * @managed_layout: a #GtkManagedLayout
+ *
+ * Returns the value set with gtk_managed_layout_set_overscan().
+ *
+ * Return value: the overscan margin in pixels
+ **/
+gint
+gtk_managed_layout_get_overscan (GtkManagedLayout     *managed_layout)
+{
+  g_return_val_if_fail (GTK_IS_MANAGED_LAYOUT (managed_layout), 0);
+
+  return managed_layout->overscan;
+}
+
+/**
+ * gtk_managed_layout_set_smooth_scrolling:
+ * @managed_layout: a #GtkManagedLayout
+ * @smooth_scrolling: whether to animate scrolling
+ *
+ * Sets whether the managed_layout scrolls to a new position of the
+ * vertical adjustment over a few frames, instead of jumping there
+ * at the next frame.
+ **/
+void
+gtk_managed_layout_set_smooth_scrolling (GtkManagedLayout     *managed_layout,
+					 gboolean       smooth_scrolling)
+{
+  g_return_if_fail (GTK_IS_MANAGED_LAYOUT (managed_layout));
+
+  smooth_scrolling = smooth_scrolling != FALSE;
+  if (managed_layout->smooth_scrolling == smooth_scrolling)
+    return;
+
+  managed_layout->smooth_scrolling = smooth_scrolling;
+  g_object_notify (G_OBJECT (managed_layout), "smooth-scrolling");
+}
+
+/**
+ * gtk_managed_layout_get_smooth_scrolling:
+ * @managed_layout: a #GtkManagedLayout
+ *
+ * Returns whether scrolling is animated.  See
+ * gtk_managed_layout_set_smooth_scrolling().
+ *
+ * Return value: %TRUE if scrolling is animated
+ **/
+gboolean
+gtk_managed_layout_get_smooth_scrolling (GtkManagedLayout     *managed_layout)
+{
+  g_return_val_if_fail (GTK_IS_MANAGED_LAYOUT (managed_layout), FALSE);
+
+  return managed_layout->smooth_scrolling;
+}
+
+/**
+ * gtk_managed_layout_set_backing_store:
+ * @managed_layout: a #GtkManagedLayout
+ * @backing_store: whether to keep a copy of the drawn content
+ *
+ * Sets whether the managed_layout keeps the content that it drew in
+ * tiles of %TILE_SIZE pixels.  When content scrolls into view again,
+ * it is copied from the tiles instead of being drawn again by the
+ * children.  A tile is thrown away when a child in it is allocated
+ * again or moved, or when any part of it is exposed for a reason other
+ * than scrolling, for example because a child queued a draw.
+ *
+ * GDK drops the draws that are queued outside the window, so children
+ * that change their appearance while they are scrolled out of view
+ * should queue a resize instead.
+ **/
+void
+gtk_managed_layout_set_backing_store (GtkManagedLayout     *managed_layout,
+				      gboolean       backing_store)
+{
+  g_return_if_fail (GTK_IS_MANAGED_LAYOUT (managed_layout));
+
+  backing_store = backing_store != FALSE;
+  if (managed_layout->backing_store == backing_store)
+    return;
+
+  managed_layout->backing_store = backing_store;
+  gtk_managed_layout_drop_tiles (managed_layout);
+  g_object_notify (G_OBJECT (managed_layout), "backing-store");
+}
+
+/**
+ * gtk_managed_layout_get_backing_store:
+ * @managed_layout: a #GtkManagedLayout
+ *
+ * Returns whether the managed_layout keeps a copy of the content it
+ * drew.  See gtk_managed_layout_set_backing_store().
+ *
+ * Return value: %TRUE if the backing store is enabled
+ **/
+gboolean
+gtk_managed_layout_get_backing_store (GtkManagedLayout     *managed_layout)
+{
+  g_return_val_if_fail (GTK_IS_MANAGED_LAYOUT (managed_layout), FALSE);
+
+  return managed_layout->backing_store;
+}
+
+/**
+ * gtk_managed_layout_set_async_layout:
+ * @managed_layout: a #GtkManagedLayout
+ * @async_layout: whether to measure labels in other threads
+ *
+ * Sets whether the managed_layout measures its wrapped labels in
+ * other threads when its width changes.  The text and the box
+ * parameters of the child are copied, the heights are computed with
+ * a #GtkLayoutEngine that all the managed_layouts share, and they are
+ * used as the estimates of gtk_layoutable_estimate_height().  The previous
+ * layout stays on screen until they are ready.
+ *
+ * Only the labels that are visible are then laid out in the main
+ * loop, so this is mostly useful together with the virtualized
+ * property.  Labels are measured with the font of the child and
+ * without their attributes; the visible ones are corrected when they
+ * are laid out.  g_thread_init() must have been called.
+ *
+ * The threads use Pango with font maps of their own, which is only
+ * safe with Pango 1.32 or newer, built against a thread-safe
+ * fontconfig (2.10.91 or newer).  With an older Pango, asynchronous
+ * layout is refused.
+ **/
+void
+gtk_managed_layout_set_async_layout (GtkManagedLayout     *managed_layout,
+				     gboolean       async_layout)
+{
+  g_return_if_fail (GTK_IS_MANAGED_LAYOUT (managed_layout));
+  g_return_if_fail (!async_layout || g_thread_supported ());
+
+  async_layout = async_layout != FALSE;
+  if (async_layout && pango_version () < PANGO_VERSION_ENCODE (1, 32, 0))
+    {
+      g_warning ("Asynchronous layout needs Pango 1.32 or newer, "
+		 "but Pango %s is in use", pango_version_string ());
+      return;
+    }
+
+  if (managed_layout->async_layout == async_layout)
+    return;
+
+  managed_layout->async_layout = async_layout;
+  if (!async_layout)
+    {
+      gtk_managed_layout_cancel_async (managed_layout);
+      gtk_widget_queue_resize (GTK_WIDGET (managed_layout));
+    }
+
+  g_object_notify (G_OBJECT (managed_layout), "async-layout");
+}
+
+/**
+ * gtk_managed_layout_get_async_layout:
+ * @managed_layout: a #GtkManagedLayout
+ *
+ * Returns whether labels are measured in other threads.  See
+ * gtk_managed_layout_set_async_layout().
+ *
+ * Return value: %TRUE if the layout is computed asynchronously
+ **/
+gboolean
+gtk_managed_layout_get_async_layout (GtkManagedLayout     *managed_layout)
+{
+  g_return_val_if_fail (GTK_IS_MANAGED_LAYOUT (managed_layout), FALSE);
+
+  return managed_layout->async_layout;
+}
+
+/**
+ * gtk_managed_layout_set_progressive_budget:
+ * @managed_layout: a #GtkManagedLayout
+ * @budget: a time in microseconds, or 0
+ *
+ * If @budget is not 0, when the width changes the managed_layout only
+ * lays out the children in and around the visible area, and lays out
+ * the others when the main loop is idle, for at most @budget
+ * microseconds at a time: first those below the visible area, then
+ * those above it.  Until then they are not shown, and the scrollbar
+ * grows as their estimated heights are replaced with the exact ones.
+ * If the width changes again the layout starts over.
+ *
+ * This has no effect if the managed_layout is virtualized, which
+ * never lays out more than the visible children.
+ **/
+void
+gtk_managed_layout_set_progressive_budget (GtkManagedLayout     *managed_layout,
+					   guint          budget)
+{
+  g_return_if_fail (GTK_IS_MANAGED_LAYOUT (managed_layout));
+
+  if (managed_layout->progressive_budget == budget)
+    return;
+
+  managed_layout->progressive_budget = budget;
+  if (!budget && managed_layout->progress_incomplete)
+    {
+      /* Lay out the rest at once.  */
+      gtk_managed_layout_cancel_progress (managed_layout);
+      gtk_widget_queue_resize (GTK_WIDGET (managed_layout));
+    }
+
+  g_object_notify (G_OBJECT (managed_layout), "progressive-budget");
+}
+
+/**
+ * gtk_managed_layout_get_progressive_budget:
+ * @managed_layout: a #GtkManagedLayout
+ *
+ * Returns the value set with gtk_managed_layout_set_progressive_budget().
+ *
+ * Return value: the time in microseconds, or 0
+ **/
+guint
+gtk_managed_layout_get_progressive_budget (GtkManagedLayout     *managed_layout)
+{
+  g_return_val_if_fail (GTK_IS_MANAGED_LAYOUT (managed_layout), 0);
+
+  return managed_layout->progressive_budget;
+}
+
+/**
+ * gtk_managed_layout_get_layout_complete:
+ * @managed_layout: a #GtkManagedLayout
+ *
+ * Returns whether all the children of @managed_layout have been laid
+ * out.  This is only %FALSE while a progressive layout, as set up
+ * with gtk_managed_layout_set_progressive_budget(), is still working
+ * through them in idle time.
+ *
+ * Return value: %TRUE if no children are left to lay out
+ **/
+gboolean
+gtk_managed_layout_get_layout_complete (GtkManagedLayout     *managed_layout)
+{
+  g_return_val_if_fail (GTK_IS_MANAGED_LAYOUT (managed_layout), TRUE);
+
+  return !managed_layout->progress_incomplete;
+}
+
+/**
+ * gtk_managed_layout_get_child_at_y:
+ * @managed_layout: a #GtkManagedLayout
+ * @y: a y coordinate relative to the top of the visible area
+ *
+ * If the child of the managed_layout is a #GtkVBox, returns the widget
+ * in it that is displayed at @y.  See gtk_layoutable_get_child_at_y().
+ *
+ * Return value: a child of the vertical box, or %NULL
+ **/
+GtkWidget*
+gtk_managed_layout_get_child_at_y (GtkManagedLayout     *managed_layout,
+				   gint           y)
+{
+  GtkWidget *child;
+
+  g_return_val_if_fail (GTK_IS_MANAGED_LAYOUT (managed_layout), NULL);
+
+  child = GTK_BIN (managed_layout)->child;
+  if (!child)
+    return NULL;
+
+  return gtk_layoutable_get_child_at_y (GTK_LAYOUTABLE (child),
+					y + (gint) managed_layout->scroll_y
+					- managed_layout->origin_y,
+					NULL);
+}
+
+/**
+ * gtk_managed_layout_scroll_to_child:
+ * @managed_layout: a #GtkManagedLayout
+ * @nth: the position of a child
+ *
+ * If the child of the managed_layout is a #GtkVBox, scrolls so that
+ * its @nth visible child is at the top of the visible area.  The child
+ * does not need to be allocated.  See gtk_layoutable_get_child_y().
+ **/
+void
+gtk_managed_layout_scroll_to_child (GtkManagedLayout     *managed_layout,
+				    gint           nth)
+{
+  GtkWidget *child;
+  gint y;
+
+  g_return_if_fail (GTK_IS_MANAGED_LAYOUT (managed_layout));
+
+  child = GTK_BIN (managed_layout)->child;
+  if (child
+      && gtk_layoutable_get_child_y (GTK_LAYOUTABLE (child), nth, &y))
+    gtk_adjustment_set_value (managed_layout->vadjustment,
+			      y + managed_layout->origin_y);
+}
+
+/**
+ * gtk_managed_layout_freeze_layout:
+ * @managed_layout: a #GtkManagedLayout
+ *
+ * Stops laying out the content of @managed_layout until
+ * gtk_managed_layout_thaw_layout() is called, for example while many
+ * children are added.  The content is neither measured nor allocated
+ * in the meanwhile.  Calls can be nested.
+ **/
+void
+gtk_managed_layout_freeze_layout (GtkManagedLayout     *managed_layout)
+{
+  g_return_if_fail (GTK_IS_MANAGED_LAYOUT (managed_layout));
+
+  managed_layout->freeze_count++;
+}
+
+/**
+ * gtk_managed_layout_thaw_layout:
+ * @managed_layout: a #GtkManagedLayout
+ *
+ * Undoes a call to gtk_managed_layout_freeze_layout().  When the last
+ * one is undone, the content is laid out once if anything changed.
+ **/
+void
+gtk_managed_layout_thaw_layout (GtkManagedLayout     *managed_layout)
+{
+  g_return_if_fail (GTK_IS_MANAGED_LAYOUT (managed_layout));
+  g_return_if_fail (managed_layout->freeze_count > 0);
+
+  if (--managed_layout->freeze_count == 0
+      && managed_layout->layout_pending)
+    {
+      managed_layout->layout_pending = FALSE;
+      gtk_widget_queue_resize (GTK_WIDGET (managed_layout));
+    }
+}
+
+/**
+ * gtk_managed_layout_pack_widgets:
+ * @managed_layout: a #GtkManagedLayout
+ * @box: a #GtkVBox or #GtkHBox inside @managed_layout
+ * @widgets: an array of widgets
+ * @n_widgets: the number of widgets
+ *
+ * Adds @widgets to @box after its other children, like calling
+ * gtk_box_pack_start() on each of them with @expand and @fill set
+ * and no padding, and lays out the content of @managed_layout once
+ * at the end.  Each widget takes O(1) time, while
+ * gtk_box_pack_start() walks all the children of the box.
+ *
+ * The list of children is changed directly, so subclasses of the
+ * boxes are not accepted, and ::add is not emitted.
+ **/
+void
+gtk_managed_layout_pack_widgets (GtkManagedLayout     *managed_layout,
+				 GtkBox        *box,
+				 GtkWidget    **widgets,
+				 guint          n_widgets)
+{
+  GtkBoxChild *child_info;
+  GList *new_children, *tail, *link;
+  guint i;
+
+  g_return_if_fail (GTK_IS_MANAGED_LAYOUT (managed_layout));
+  g_return_if_fail (G_OBJECT_TYPE (box) == GTK_TYPE_VBOX
+		    || G_OBJECT_TYPE (box) == GTK_TYPE_HBOX);
+  g_return_if_fail (gtk_widget_is_ancestor (GTK_WIDGET (box),
+					    GTK_WIDGET (managed_layout)));
+  g_return_if_fail (widgets != NULL || n_widgets == 0);
+  for (i = 0; i < n_widgets; i++)
+    {
+      g_return_if_fail (GTK_IS_WIDGET (widgets[i]));
+      g_return_if_fail (widgets[i]->parent == NULL);
+    }
+
+  if (n_widgets == 0)
+    return;
+
+  /* Build the GtkBoxChild entries like gtk_box_pack_start does, but
+     append them through a tail pointer, and only parent the widgets
+     once the box has all of its children.  */
+  new_children = tail = NULL;
+  for (i = 0; i < n_widgets; i++)
+    {
+      child_info = g_new0 (GtkBoxChild, 1);
+      child_info->widget = widgets[i];
+      child_info->padding = 0;
+      child_info->expand = TRUE;
+      child_info->fill = TRUE;
+      child_info->pack = GTK_PACK_START;
+
+      link = g_list_alloc ();
+      link->data = child_info;
+      link->prev = tail;
+      if (tail)
+	tail->next = link;
+      else
+	new_children = link;
+      tail = link;
+    }
+
+  box->children = g_list_concat (box->children, new_children);
+
+  for (i = 0; i < n_widgets; i++)
+    {
+      gtk_widget_freeze_child_notify (widgets[i]);
+      gtk_widget_set_parent (widgets[i], GTK_WIDGET (box));
+      gtk_widget_child_notify (widgets[i], "expand");
+      gtk_widget_child_notify (widgets[i], "fill");
+      gtk_widget_child_notify (widgets[i], "padding");
+      gtk_widget_child_notify (widgets[i], "pack-type");
+      gtk_widget_child_notify (widgets[i], "position");
+      gtk_widget_thaw_child_notify (widgets[i]);
+    }
+
+  gtk_widget_queue_resize (GTK_WIDGET (box));
+}
+
+/* Returns whether ::value-changed was emitted.  */
+static gboolean
 gtk_managed_layout_set_adjustment_upper (GtkAdjustment *adj,
 				         gdouble        upper,
 				         gboolean       always_emit_changed)
@@ -326,6 +913,8 @@ gtk_managed_layout_set_adjustment_upper (GtkAdjustment *adj,
     gtk_adjustment_changed (adj);
   if (value_changed)
     gtk_adjustment_value_changed (adj);
+
+  return value_changed;
 }
 
 /* Basic Object handling procedures
@@ -368,6 +957,56 @@ gtk_managed_layout_class_init (GtkManagedLayoutClass *class)
 							GTK_TYPE_ADJUSTMENT,
 							G_PARAM_READWRITE));
 
+  g_object_class_install_property (gobject_class,
+				   PROP_VIRTUALIZED,
+				   g_param_spec_boolean ("virtualized",
+							 P_("Virtualized"),
+							 P_("Whether to allocate only the visible children"),
+							 FALSE,
+							 G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class,
+				   PROP_OVERSCAN,
+				   g_param_spec_int ("overscan",
+						     P_("Overscan"),
+						     P_("Number of pixels above and below the visible area that are allocated"),
+						     0, G_MAXINT, 256,
+						     G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class,
+				   PROP_SMOOTH_SCROLLING,
+				   g_param_spec_boolean ("smooth-scrolling",
+							 P_("Smooth scrolling"),
+							 P_("Whether to animate scrolling"),
+							 FALSE,
+							 G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class,
+				   PROP_BACKING_STORE,
+				   g_param_spec_boolean ("backing-store",
+							 P_("Backing store"),
+							 P_("Whether to keep a copy of the drawn content to scroll over it faster"),
+							 FALSE,
+							 G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class,
+				   PROP_ASYNC_LAYOUT,
+				   g_param_spec_boolean ("async-layout",
+							 P_("Asynchronous layout"),
+							 P_("Whether to measure the labels in other threads when the width changes"),
+							 FALSE,
+							 G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class,
+				   PROP_PROGRESSIVE_BUDGET,
+				   g_param_spec_uint ("progressive-budget",
+						      P_("Progressive budget"),
+						      P_("How many microseconds to spend laying out the children outside the visible area at a time, or 0 to lay them out at once"),
+						      0,
+						      G_MAXUINT,
+						      0,
+						      G_PARAM_READWRITE));
+
   widget_class->realize = gtk_managed_layout_realize;
   widget_class->unrealize = gtk_managed_layout_unrealize;
   widget_class->map = gtk_managed_layout_map;
@@ -407,6 +1046,24 @@ gtk_managed_layout_get_property (GObject     *object,
     case PROP_VADJUSTMENT:
       g_value_set_object (value, managed_layout->vadjustment);
       break;
+    case PROP_VIRTUALIZED:
+      g_value_set_boolean (value, managed_layout->virtualized);
+      break;
+    case PROP_OVERSCAN:
+      g_value_set_int (value, managed_layout->overscan);
+      break;
+    case PROP_SMOOTH_SCROLLING:
+      g_value_set_boolean (value, managed_layout->smooth_scrolling);
+      break;
+    case PROP_BACKING_STORE:
+      g_value_set_boolean (value, managed_layout->backing_store);
+      break;
+    case PROP_ASYNC_LAYOUT:
+      g_value_set_boolean (value, managed_layout->async_layout);
+      break;
+    case PROP_PROGRESSIVE_BUDGET:
+      g_value_set_uint (value, managed_layout->progressive_budget);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -431,6 +1088,30 @@ gtk_managed_layout_set_property (GObject      *object,
       gtk_managed_layout_set_vadjustment (managed_layout, 
 				  (GtkAdjustment*) g_value_get_object (value));
       break;
+    case PROP_VIRTUALIZED:
+      gtk_managed_layout_set_virtualized (managed_layout,
+					  g_value_get_boolean (value));
+      break;
+    case PROP_OVERSCAN:
+      gtk_managed_layout_set_overscan (managed_layout,
+				       g_value_get_int (value));
+      break;
+    case PROP_SMOOTH_SCROLLING:
+      gtk_managed_layout_set_smooth_scrolling (managed_layout,
+					       g_value_get_boolean (value));
+      break;
+    case PROP_BACKING_STORE:
+      gtk_managed_layout_set_backing_store (managed_layout,
+					    g_value_get_boolean (value));
+      break;
+    case PROP_ASYNC_LAYOUT:
+      gtk_managed_layout_set_async_layout (managed_layout,
+					   g_value_get_boolean (value));
+      break;
+    case PROP_PROGRESSIVE_BUDGET:
+      gtk_managed_layout_set_progressive_budget (managed_layout,
+						 g_value_get_uint (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -450,6 +1131,33 @@ gtk_managed_layout_init (GtkManagedLayout *managed_layout)
   managed_layout->hadjustment = NULL;
   managed_layout->vadjustment = NULL;
 
+  managed_layout->overscan = 256;
+  managed_layout->virtualized = FALSE;
+  managed_layout->origin_y = 0;
+  managed_layout->scroll_y = 0;
+  managed_layout->frame_timer = 0;
+  managed_layout->smooth_scrolling = FALSE;
+
+  managed_layout->backing_store = FALSE;
+  managed_layout->tiles = g_hash_table_new (NULL, NULL);
+  managed_layout->tile_queue = g_queue_new ();
+  managed_layout->shown.x = managed_layout->shown.y = 0;
+  managed_layout->shown.width = managed_layout->shown.height = 0;
+  managed_layout->uncovered = gdk_region_new ();
+
+  managed_layout->layout_width = -1;
+  managed_layout->async_job = NULL;
+  managed_layout->async_layout = FALSE;
+
+  managed_layout->freeze_count = 0;
+  managed_layout->layout_pending = FALSE;
+
+  managed_layout->progressive_budget = 0;
+  managed_layout->progress_idle = 0;
+  managed_layout->progress_top = 0;
+  managed_layout->progress_bottom = 0;
+  managed_layout->progress_incomplete = FALSE;
+
   managed_layout->bin_window = NULL;
 }
 
@@ -512,9 +1220,9 @@ gtk_managed_layout_realize (GtkWidget *widget)
   gdk_window_set_user_data (widget->window, widget);
 
   attributes.x = - managed_layout->hadjustment->value,
-  attributes.y = - managed_layout->vadjustment->value;
+  attributes.y = managed_layout->origin_y - managed_layout->scroll_y;
   attributes.width = MAX (managed_layout->width, widget->allocation.width);
-  attributes.height = MAX (managed_layout->height, widget->allocation.height);
+  attributes.height = gtk_managed_layout_get_bin_height (managed_layout);
   attributes.event_mask = GDK_EXPOSURE_MASK | GDK_SCROLL_MASK | 
                           gtk_widget_get_events (widget);
 
@@ -568,6 +1276,8 @@ gtk_managed_layout_style_set (GtkWidget *widget, GtkStyle *old_style)
     {
       gtk_style_set_background (widget->style, GTK_MANAGED_LAYOUT (widget)->bin_window, GTK_STATE_NORMAL);
     }
+
+  gtk_managed_layout_drop_tiles (GTK_MANAGED_LAYOUT (widget));
 }
 
 static void 
@@ -579,6 +1289,15 @@ gtk_managed_layout_unrealize (GtkWidget *widget)
 
   managed_layout = GTK_MANAGED_LAYOUT (widget);
 
+  if (managed_layout->frame_timer)
+    {
+      g_source_remove (managed_layout->frame_timer);
+      managed_layout->frame_timer = 0;
+    }
+  gtk_managed_layout_cancel_progress (managed_layout);
+  managed_layout->scroll_y = managed_layout->vadjustment->value;
+  gtk_managed_layout_drop_tiles (managed_layout);
+
   gdk_window_set_user_data (managed_layout->bin_window, NULL);
   gdk_window_destroy (managed_layout->bin_window);
   managed_layout->bin_window = NULL;
@@ -605,68 +1324,298 @@ gtk_managed_layout_size_request (GtkWidget     *widget,
   child = GTK_LAYOUTABLE (bin->child);
   border_width = GTK_CONTAINER (widget)->border_width;
 
-  gtk_layoutable_size_request (child, &child_requisition);
-  managed_layout->width = child_requisition.width + 2 * border_width;
-  managed_layout->height = child_requisition.height + 2 * border_width;
-  managed_layout->requested_width = widget->allocation.width;
-  managed_layout->requested_height = widget->allocation.height;
-
   requisition->width = 0;
   requisition->height = 0;
+  if (managed_layout->freeze_count > 0)
+    {
+      managed_layout->layout_pending = TRUE;
+      return;
+    }
+
+  /* The actual size of the child depends on the width we are
+     allocated, so we do not ask for any space; size_allocate
+     lays out the child for the new width in the same pass.  */
+  if (child)
+    gtk_layoutable_size_request (child, &child_requisition);
+  else
+    child_requisition.width = child_requisition.height = 0;
+  managed_layout->requested_width = child_requisition.width + 2 * border_width;
+  managed_layout->requested_height = child_requisition.height + 2 * border_width;
 }
 
-static void     
-gtk_managed_layout_size_allocate (GtkWidget     *widget,
-			  GtkAllocation *allocation)
+/* Start from the requisition, not from the previous width, so that
+   the content can shrink together with the window.  */
+static gint
+gtk_managed_layout_get_child_width (GtkManagedLayout *managed_layout)
 {
-  GtkBin *bin;
+  GtkWidget *widget = GTK_WIDGET (managed_layout);
+
+  return MAX (managed_layout->requested_width, widget->allocation.width)
+    - 2 * GTK_CONTAINER (widget)->border_width;
+}
+
+/* Lay out the child and return how much the content that was at the
+   top of the viewport moved, because the estimated heights of the
+   children above it were replaced with the exact ones.  */
+static gint
+gtk_managed_layout_allocate_child (GtkManagedLayout *managed_layout)
+{
+  GtkWidget *widget;
+  GdkRectangle visible;
+  gint width;
+  gint dy;
+
+  widget = GTK_WIDGET (managed_layout);
+  width = gtk_managed_layout_get_child_width (managed_layout);
+
+  visible.x = 0;
+  visible.y = (gint) managed_layout->scroll_y - managed_layout->overscan;
+  visible.width = G_MAXINT;
+  visible.height = widget->allocation.height + 2 * managed_layout->overscan;
+
+  /* In progressive mode, a new width is laid out around the viewport
+     first, and gtk_managed_layout_progress does the rest.  A pass
+     that is still going on starts over.  */
+  if (managed_layout->progressive_budget > 0
+      && !managed_layout->virtualized
+      && (width != managed_layout->layout_width
+	  || managed_layout->progress_incomplete))
+    {
+      dy = gtk_managed_layout_allocate_area (managed_layout, &visible, FALSE);
+      managed_layout->progress_top = visible.y;
+      managed_layout->progress_bottom = visible.y + visible.height;
+      managed_layout->progress_incomplete =
+	!gtk_managed_layout_progress_done (managed_layout);
+      if (!managed_layout->progress_incomplete)
+	gtk_managed_layout_cancel_progress (managed_layout);
+      else if (!managed_layout->progress_idle)
+	managed_layout->progress_idle =
+	  gdk_threads_add_idle (gtk_managed_layout_progress, managed_layout);
+      return dy;
+    }
+
+  gtk_managed_layout_cancel_progress (managed_layout);
+  managed_layout->progress_incomplete = FALSE;
+
+  if (managed_layout->virtualized)
+    {
+      managed_layout->visible_top = visible.y;
+      managed_layout->visible_bottom = visible.y + visible.height;
+      return gtk_managed_layout_allocate_area (managed_layout, &visible, FALSE);
+    }
+
+  return gtk_managed_layout_allocate_area (managed_layout, NULL, FALSE);
+}
+
+/* Lay out the children of the child in AREA, which is in the
+   coordinates of the content, and cull the others; or all of them if
+   AREA is NULL.  If KEEP, the children that are already laid out next
+   to AREA stay so.  Returns the same as allocate_child.  */
+static gint
+gtk_managed_layout_allocate_area (GtkManagedLayout   *managed_layout,
+				  const GdkRectangle *area,
+				  gboolean            keep)
+{
+  GtkWidget *widget;
   GtkLayoutable *child;
-  GtkManagedLayout *managed_layout;
   GtkAllocation child_allocation;
+  GdkRectangle visible;
+  GdkRegion *damage;
   gint border_width;
-  gboolean size_changed;
+  gint anchor;
 
-  g_return_if_fail (GTK_IS_MANAGED_LAYOUT (widget));
-
-  bin = GTK_BIN (widget);
-  managed_layout = GTK_MANAGED_LAYOUT (widget);
+  widget = GTK_WIDGET (managed_layout);
+  if (!GTK_BIN (managed_layout)->child)
+    {
+      gtk_managed_layout_update_size (managed_layout);
+      return 0;
+    }
 
-  child = GTK_LAYOUTABLE (bin->child);
+  child = GTK_LAYOUTABLE (GTK_BIN (managed_layout)->child);
   border_width = GTK_CONTAINER (widget)->border_width;
 
-  size_changed =
-    (managed_layout->requested_width != allocation->width ||
-     managed_layout->requested_height != allocation->height);
-  
-  widget->allocation = *allocation;
-  if (size_changed)
-    gtk_widget_queue_resize (widget);
-
-  managed_layout->width = MAX (managed_layout->width, allocation->width);
-  managed_layout->height = MAX (managed_layout->height, allocation->height);
-
+  /* The children are positioned relative to the top of the
+     bin_window.  */
   child_allocation.x = border_width;
-  child_allocation.y = border_width;
-  child_allocation.width = managed_layout->width - 2 * border_width;
+  child_allocation.y = border_width - managed_layout->origin_y;
+  child_allocation.width = gtk_managed_layout_get_child_width (managed_layout);
   child_allocation.height = 0;
+  managed_layout->layout_width = child_allocation.width;
 
-  gtk_layoutable_size_allocate (child, &child_allocation);
+  damage = NULL;
+  if (managed_layout->backing_store)
+    {
+      damage = gdk_region_new ();
+      gtk_layoutable_track_damage (damage);
+    }
 
-  managed_layout->width = MAX (child_allocation.x + child_allocation.width + border_width,
-			     allocation->width);
-  managed_layout->height = MAX (child_allocation.y + child_allocation.height + border_width,
-			      allocation->height);
+  if (area)
+    {
+      visible = *area;
+      visible.y -= managed_layout->origin_y;
+
+      anchor = (gint) managed_layout->scroll_y - managed_layout->origin_y;
+      if (keep)
+	gtk_layoutable_size_allocate_more (child, &child_allocation,
+					   &visible, &anchor);
+      else
+	gtk_layoutable_size_allocate_visible (child, &child_allocation,
+					      &visible, &anchor);
+      anchor -= (gint) managed_layout->scroll_y - managed_layout->origin_y;
+    }
+  else
+    {
+      gtk_layoutable_size_allocate (child, &child_allocation);
+      anchor = 0;
+    }
 
-  if (GTK_WIDGET_REALIZED (widget))
+  if (damage)
+    {
+      gtk_layoutable_track_damage (NULL);
+      gtk_managed_layout_damage_tiles (managed_layout, damage);
+      gdk_region_destroy (damage);
+    }
+
+  gtk_managed_layout_update_size (managed_layout);
+  return anchor;
+}
+
+/* Compute the size of the content from the allocation of the child,
+   which is relative to the top of the bin_window.  */
+static void
+gtk_managed_layout_update_size (GtkManagedLayout *managed_layout)
+{
+  GtkWidget *widget;
+  GtkAllocation *child_allocation;
+  gint border_width;
+
+  widget = GTK_WIDGET (managed_layout);
+  if (!GTK_BIN (managed_layout)->child)
     {
-      gdk_window_move_resize (widget->window,
-			      allocation->x, allocation->y,
-			      allocation->width, allocation->height);
+      managed_layout->width = widget->allocation.width;
+      managed_layout->height = widget->allocation.height;
+      return;
+    }
+
+  child_allocation = &GTK_BIN (managed_layout)->child->allocation;
+  border_width = GTK_CONTAINER (widget)->border_width;
+
+  managed_layout->width = MAX (child_allocation->x + child_allocation->width + border_width,
+			     widget->allocation.width);
+  managed_layout->height = MAX (managed_layout->origin_y + child_allocation->y +
+				child_allocation->height + border_width,
+			      widget->allocation.height);
+}
+
+/* Whether the child is laid out at the current width, and covers the
+   viewport if it is virtualized or laid out progressively.  A new
+   allocation then does not need to lay it out again; the layout does
+   not depend on the height.  */
+static gboolean
+gtk_managed_layout_child_is_current (GtkManagedLayout *managed_layout)
+{
+  GtkWidget *child;
+  gint width;
+
+  child = GTK_BIN (managed_layout)->child;
+  width = gtk_managed_layout_get_child_width (managed_layout);
+  if (!child
+      || width != managed_layout->layout_width
+      || !gtk_layoutable_is_allocated (GTK_LAYOUTABLE (child), width))
+    return FALSE;
+
+  if (managed_layout->progress_incomplete)
+    return gtk_managed_layout_progress_covers (managed_layout);
+
+  return (!managed_layout->virtualized
+	  || (managed_layout->scroll_y >= managed_layout->visible_top
+	      && (managed_layout->scroll_y
+		  + GTK_WIDGET (managed_layout)->allocation.height
+		  <= managed_layout->visible_bottom)));
+}
+
+/* The bin_window covers the content from origin_y down, but it is
+   only a few viewports tall, so that it never hits the X11 limit
+   of 32767 pixels and moving it stays cheap.  */
+static gint
+gtk_managed_layout_get_bin_height (GtkManagedLayout *managed_layout)
+{
+  gint page_size;
+
+  page_size = GTK_WIDGET (managed_layout)->allocation.height;
+  return MAX (MIN (managed_layout->height - managed_layout->origin_y,
+		   BIN_WINDOW_PAGES * page_size),
+	      page_size);
+}
+
+/* If the viewport is not inside the bin_window anymore, put the top of
+   the bin_window one viewport above it, and return TRUE.  */
+static gboolean
+gtk_managed_layout_update_origin (GtkManagedLayout *managed_layout)
+{
+  gint value, page_size;
+
+  value = (gint) managed_layout->scroll_y;
+  page_size = GTK_WIDGET (managed_layout)->allocation.height;
+  if (value >= managed_layout->origin_y
+      && (value + page_size
+	  <= managed_layout->origin_y + gtk_managed_layout_get_bin_height (managed_layout)))
+    return FALSE;
+
+  managed_layout->origin_y = MAX (value - page_size, 0);
+  return TRUE;
+}
+
+static void     
+gtk_managed_layout_size_allocate (GtkWidget     *widget,
+			  GtkAllocation *allocation)
+{
+  GtkManagedLayout *managed_layout;
+  gboolean origin_changed;
+  gint dy;
+
+  g_return_if_fail (GTK_IS_MANAGED_LAYOUT (widget));
+
+  managed_layout = GTK_MANAGED_LAYOUT (widget);
+
+  /* The size of the bin_window depends on the allocation; drop the
+     tiles at its edges together with everything else.  */
+  if (widget->allocation.width != allocation->width
+      || widget->allocation.height != allocation->height)
+    gtk_managed_layout_drop_tiles (managed_layout);
 
-      gdk_window_resize (managed_layout->bin_window,
-		         managed_layout->width, managed_layout->height);
+  /* The windows of the children are configured once, after the
+     pass, and then the windows of the layout.  */
+  _gtk_configure_batch_begin ();
+
+  widget->allocation = *allocation;
+  origin_changed = gtk_managed_layout_update_origin (managed_layout);
+  if (origin_changed)
+    gtk_managed_layout_drop_tiles (managed_layout);
+
+  /* Keep the previous layout until the thread pool is done with
+     the new width, or until the layout is thawed.  If only the
+     height changed, the children stay where they are.  */
+  if (managed_layout->freeze_count > 0)
+    {
+      managed_layout->layout_pending = TRUE;
+      dy = 0;
+    }
+  else if (managed_layout->async_layout
+	   && gtk_managed_layout_start_async (managed_layout))
+    dy = 0;
+  else if (!origin_changed
+	   && gtk_managed_layout_child_is_current (managed_layout))
+    {
+      gtk_managed_layout_update_size (managed_layout);
+      dy = 0;
     }
+  else
+    dy = gtk_managed_layout_allocate_child (managed_layout);
 
+  /* Settle the scroll position before the bin_window is placed, or
+     the content would be painted at the old offset until the next
+     frame.  ::value-changed only arms the frame timer.  */
   managed_layout->hadjustment->page_size = allocation->width;
   managed_layout->hadjustment->page_increment = allocation->width * 0.9;
   managed_layout->hadjustment->lower = 0;
@@ -678,8 +1627,616 @@ gtk_managed_layout_size_allocate (GtkWidget     *widget,
   managed_layout->vadjustment->page_increment = allocation->height * 0.9;
   managed_layout->vadjustment->lower = 0;
   managed_layout->vadjustment->upper = managed_layout->height;
-  gtk_managed_layout_set_adjustment_upper (managed_layout->vadjustment,
-					 managed_layout->height, TRUE);
+  managed_layout->vadjustment->value = MAX (managed_layout->vadjustment->value + dy, 0.);
+  managed_layout->scroll_y = CLAMP (managed_layout->scroll_y + dy, 0.,
+				    MAX (0., managed_layout->height - allocation->height));
+  /* Emit ::value-changed once, after the value is clamped.  */
+  if (!gtk_managed_layout_set_adjustment_upper (managed_layout->vadjustment,
+						managed_layout->height, TRUE)
+      && dy)
+    gtk_adjustment_value_changed (managed_layout->vadjustment);
+
+  if (GTK_WIDGET_REALIZED (widget))
+    {
+      _gtk_configure_batch_move_resize (widget->window,
+					allocation->x, allocation->y,
+					allocation->width, allocation->height);
+
+      gtk_managed_layout_move_bin_window (managed_layout);
+    }
+
+  _gtk_configure_batch_end ();
+}
+
+/* Progressive layout
+ */
+
+/* Whether the children that are laid out cover the viewport, and the
+   rest of them is being laid out.  */
+static gboolean
+gtk_managed_layout_progress_covers (GtkManagedLayout *managed_layout)
+{
+  return (managed_layout->progress_idle
+	  && managed_layout->scroll_y >= managed_layout->progress_top
+	  && (managed_layout->scroll_y
+	      + GTK_WIDGET (managed_layout)->allocation.height
+	      <= managed_layout->progress_bottom));
+}
+
+static gboolean
+gtk_managed_layout_progress_done (GtkManagedLayout *managed_layout)
+{
+  return (managed_layout->progress_top <= 0
+	  && managed_layout->progress_bottom >= managed_layout->height);
+}
+
+/* Lay out one viewport of children next to those that are laid out
+   already, below them until the bottom of the content is reached
+   and then above them, until the budget is spent.  Only the children
+   in each new area are visited, so a step costs the same wherever it
+   is in the content.  */
+static gboolean
+gtk_managed_layout_progress (gpointer data)
+{
+  GtkManagedLayout *managed_layout = data;
+  GtkWidget *widget = data;
+  GdkRectangle area;
+  GTimer *timer;
+  gint band, dy, moved;
+
+  /* The layout starts over when it is thawed.  */
+  if (managed_layout->freeze_count > 0 || !GTK_BIN (managed_layout)->child)
+    {
+      if (managed_layout->freeze_count > 0)
+	managed_layout->layout_pending = TRUE;
+      managed_layout->progress_idle = 0;
+      return FALSE;
+    }
+
+  band = MAX (widget->allocation.height, 1);
+  area.x = 0;
+  area.width = G_MAXINT;
+  area.height = band;
+  moved = 0;
+
+  _gtk_configure_batch_begin ();
+  timer = g_timer_new ();
+  while (!gtk_managed_layout_progress_done (managed_layout)
+	 && (g_timer_elapsed (timer, NULL) * 1e6
+	     < managed_layout->progressive_budget))
+    {
+      if (managed_layout->progress_bottom < managed_layout->height)
+	{
+	  area.y = managed_layout->progress_bottom;
+	  dy = gtk_managed_layout_allocate_area (managed_layout, &area, TRUE);
+	  managed_layout->progress_bottom += band;
+	}
+      else
+	{
+	  /* The exact heights of these children move everything below
+	     them, including the viewport.  */
+	  area.y = managed_layout->progress_top - band;
+	  dy = gtk_managed_layout_allocate_area (managed_layout, &area, TRUE);
+	  managed_layout->progress_top = area.y;
+	  managed_layout->progress_bottom += dy;
+	}
+
+      managed_layout->vadjustment->value =
+	MAX (managed_layout->vadjustment->value + dy, 0.);
+      managed_layout->scroll_y = MAX (managed_layout->scroll_y + dy, 0.);
+      moved += dy;
+    }
+  g_timer_destroy (timer);
+
+  /* If the viewport moved out of the bin_window, everything that is
+     laid out moves together with the bin_window.  */
+  if (gtk_managed_layout_update_origin (managed_layout))
+    {
+      gtk_managed_layout_drop_tiles (managed_layout);
+      area.y = managed_layout->progress_top;
+      area.height = managed_layout->progress_bottom - managed_layout->progress_top;
+      gtk_managed_layout_allocate_area (managed_layout, &area, TRUE);
+      if (GTK_WIDGET_REALIZED (widget))
+	gdk_window_invalidate_rect (managed_layout->bin_window, NULL, TRUE);
+    }
+
+  if (GTK_WIDGET_REALIZED (widget))
+    gtk_managed_layout_move_bin_window (managed_layout);
+  _gtk_configure_batch_end ();
+
+  if (!gtk_managed_layout_set_adjustment_upper (managed_layout->vadjustment,
+						managed_layout->height, FALSE)
+      && moved)
+    gtk_adjustment_value_changed (managed_layout->vadjustment);
+
+  if (!gtk_managed_layout_progress_done (managed_layout))
+    return TRUE;
+
+  managed_layout->progress_incomplete = FALSE;
+  managed_layout->progress_idle = 0;
+  return FALSE;
+}
+
+/* Run the rest of a progressive layout right away, one slice after
+   another.  Used by the benchmark, which must not let the main loop
+   run anything else in the meanwhile.  */
+void
+_gtk_managed_layout_flush_progress (GtkManagedLayout *managed_layout)
+{
+  g_return_if_fail (GTK_IS_MANAGED_LAYOUT (managed_layout));
+
+  if (!managed_layout->progress_idle)
+    return;
+
+  /* progress_idle is cleared by the last slice.  */
+  g_source_remove (managed_layout->progress_idle);
+  while (gtk_managed_layout_progress (managed_layout))
+    ;
+}
+
+/* Stop laying out the children in idle time.  progress_incomplete
+   stays set, so the next allocation starts over.  */
+static void
+gtk_managed_layout_cancel_progress (GtkManagedLayout *managed_layout)
+{
+  if (managed_layout->progress_idle)
+    {
+      g_source_remove (managed_layout->progress_idle);
+      managed_layout->progress_idle = 0;
+    }
+}
+
+/* Asynchronous layout
+ */
+static GtkLayoutNode *
+gtk_managed_layout_snapshot (GtkWidget *widget,
+			     GSList   **labels)
+{
+  GtkLayoutNode *node;
+  GtkRequisition requisition;
+  GtkBoxChild *child;
+  GList *list;
+
+  if (GTK_IS_LABEL (widget) && gtk_label_get_line_wrap (GTK_LABEL (widget)))
+    {
+      node = gtk_layout_node_new_text (gtk_label_get_text (GTK_LABEL (widget)),
+				       TRUE);
+      node->xpad = GTK_MISC (widget)->xpad;
+      node->ypad = GTK_MISC (widget)->ypad;
+      node->user_data = widget;
+      *labels = g_slist_prepend (*labels, g_object_ref (widget));
+    }
+
+  else if (GTK_IS_VBOX (widget) || GTK_IS_HBOX (widget))
+    {
+      if (GTK_IS_VBOX (widget))
+	node = gtk_layout_node_new_vbox (GTK_BOX (widget)->spacing);
+      else
+	node = gtk_layout_node_new_hbox (GTK_BOX (widget)->spacing);
+
+      node->border_width = GTK_CONTAINER (widget)->border_width;
+      for (list = GTK_BOX (widget)->children; list; list = list->next)
+	{
+	  child = list->data;
+	  if (GTK_WIDGET_VISIBLE (child->widget))
+	    gtk_layout_node_append (node,
+				    gtk_managed_layout_snapshot (child->widget, labels),
+				    child->padding, child->pack == GTK_PACK_END);
+	}
+    }
+
+  /* Other widgets are not measured again; they are assumed to keep
+     their requisition.  */
+  else
+    {
+      gtk_widget_get_child_requisition (widget, &requisition);
+      node = gtk_layout_node_new_fixed (requisition.width, requisition.height);
+    }
+
+  return node;
+}
+
+static void
+gtk_managed_layout_job_free (GtkManagedLayoutJob *job)
+{
+  g_slist_foreach (job->labels, (GFunc) g_object_unref, NULL);
+  g_slist_free (job->labels);
+  gtk_layout_node_free (job->root);
+  pango_font_description_free (job->font);
+  if (job->font_options)
+    cairo_font_options_destroy (job->font_options);
+  g_object_unref (job->managed_layout);
+  g_slice_free (GtkManagedLayoutJob, job);
+}
+
+/* Since Pango 1.32, and as long as fontconfig is thread-safe, font
+   maps can be used from several threads as long as each one is only
+   used by one thread at a time; so the engine and each of its helpers
+   get their own.  gtk_managed_layout_set_async_layout checks the
+   version of Pango.  */
+static GtkLayoutEngine *
+gtk_managed_layout_worker_add_engine (GtkManagedLayoutWorker *worker)
+{
+  PangoFontMap *font_map;
+  PangoContext *context;
+
+  font_map = pango_cairo_font_map_new ();
+  context = pango_cairo_font_map_create_context (PANGO_CAIRO_FONT_MAP (font_map));
+  g_ptr_array_add (worker->contexts, context);
+  g_object_unref (font_map);
+
+  return gtk_layout_engine_new_for_pango (context);
+}
+
+static GtkManagedLayoutWorker *
+gtk_managed_layout_get_worker (void)
+{
+  GtkManagedLayoutWorker *worker;
+  glong n_helpers;
+
+  /* Only the thread of async_layout_pool gets here, one job at a
+     time, so the worker is created once and shared by all jobs.  */
+  if (async_layout_worker)
+    return async_layout_worker;
+
+  worker = g_slice_new (GtkManagedLayoutWorker);
+  worker->contexts = g_ptr_array_new ();
+  worker->engine = gtk_managed_layout_worker_add_engine (worker);
+
+  n_helpers = CLAMP (sysconf (_SC_NPROCESSORS_ONLN) - 1,
+		     0, ASYNC_LAYOUT_MAX_HELPERS);
+  while (n_helpers-- > 0)
+    gtk_layout_engine_add_helper (worker->engine,
+				  gtk_managed_layout_worker_add_engine (worker));
+
+  async_layout_worker = worker;
+  return worker;
+}
+
+/* Seed the estimates of the labels that did not change since the
+   snapshot was taken.  */
+static void
+gtk_managed_layout_apply_node (GtkLayoutNode *node)
+{
+  GtkLayoutNode *child;
+  GtkLabel *label;
+
+  if (node->type == GTK_LAYOUT_NODE_TEXT)
+    {
+      label = node->user_data;
+      if (gtk_label_get_line_wrap (label)
+	  && label->misc.xpad == node->xpad
+	  && label->misc.ypad == node->ypad
+	  && !strcmp (gtk_label_get_text (label), node->text))
+	gtk_layoutable_set_estimated_height (GTK_LAYOUTABLE (label),
+					     node->available_width,
+					     node->height);
+    }
+
+  for (child = node->children; child; child = child->next)
+    gtk_managed_layout_apply_node (child);
+}
+
+static gboolean
+gtk_managed_layout_async_done (gpointer data)
+{
+  GtkManagedLayoutJob *job = data;
+  GtkManagedLayout *managed_layout = job->managed_layout;
+
+  if (managed_layout->async_job == job)
+    {
+      managed_layout->async_job = NULL;
+      gtk_managed_layout_apply_node (job->root);
+
+      /* The next size_allocate lays out the child at the new width,
+	 using the estimates for the children that are not visible.  */
+      managed_layout->layout_width = job->width;
+      gtk_widget_queue_resize (GTK_WIDGET (managed_layout));
+    }
+
+  gtk_managed_layout_job_free (job);
+  return FALSE;
+}
+
+static void
+gtk_managed_layout_async_run (gpointer data,
+			      gpointer user_data)
+{
+  GtkManagedLayoutJob *job = data;
+  GtkManagedLayoutWorker *worker;
+  PangoContext *context;
+  guint i;
+
+  if (!g_atomic_int_get (&job->cancelled))
+    {
+      worker = gtk_managed_layout_get_worker ();
+      for (i = 0; i < worker->contexts->len; i++)
+	{
+	  context = g_ptr_array_index (worker->contexts, i);
+	  pango_context_set_font_description (context, job->font);
+	  pango_cairo_context_set_resolution (context, job->resolution);
+	  pango_cairo_context_set_font_options (context, job->font_options);
+	}
+
+      gtk_layout_engine_allocate (worker->engine, job->root, 0, 0, job->width);
+    }
+
+  gdk_threads_add_idle (gtk_managed_layout_async_done, job);
+}
+
+/* Return TRUE if the child has to be laid out at a new width, and a
+   snapshot of it was given to the thread pool or is already there.  */
+static gboolean
+gtk_managed_layout_start_async (GtkManagedLayout *managed_layout)
+{
+  GtkManagedLayoutJob *job;
+  GtkWidget *widget;
+  GtkWidget *child;
+  GdkScreen *screen;
+  const cairo_font_options_t *font_options;
+  gint width;
+
+  widget = GTK_WIDGET (managed_layout);
+  child = GTK_BIN (managed_layout)->child;
+  width = gtk_managed_layout_get_child_width (managed_layout);
+  if (width == managed_layout->layout_width)
+    return FALSE;
+
+  job = managed_layout->async_job;
+  if (job && job->width == width)
+    return TRUE;
+
+  gtk_managed_layout_cancel_async (managed_layout);
+  if (!async_layout_pool)
+    async_layout_pool = g_thread_pool_new (gtk_managed_layout_async_run, NULL,
+					   1, FALSE, NULL);
+
+  screen = gtk_widget_get_screen (widget);
+  font_options = gdk_screen_get_font_options (screen);
+
+  job = g_slice_new0 (GtkManagedLayoutJob);
+  job->managed_layout = g_object_ref (managed_layout);
+  job->root = gtk_managed_layout_snapshot (child, &job->labels);
+  job->font = pango_font_description_copy (child->style->font_desc);
+  job->font_options = font_options ? cairo_font_options_copy (font_options) : NULL;
+  job->resolution = gdk_screen_get_resolution (screen);
+  job->width = width;
+
+  managed_layout->async_job = job;
+  g_thread_pool_push (async_layout_pool, job, NULL);
+  return TRUE;
+}
+
+/* The job still runs, unless it was not started yet, but its result
+   is thrown away.  */
+static void
+gtk_managed_layout_cancel_async (GtkManagedLayout *managed_layout)
+{
+  GtkManagedLayoutJob *job;
+
+  job = managed_layout->async_job;
+  if (job)
+    {
+      g_atomic_int_set (&job->cancelled, TRUE);
+      managed_layout->async_job = NULL;
+    }
+}
+
+static void
+gtk_managed_layout_drop_tile (GtkManagedLayout     *managed_layout,
+			      GtkManagedLayoutTile *tile)
+{
+  g_hash_table_remove (managed_layout->tiles, GUINT_TO_POINTER (tile->key));
+  g_queue_delete_link (managed_layout->tile_queue, tile->link);
+  g_object_unref (tile->pixmap);
+  g_slice_free (GtkManagedLayoutTile, tile);
+}
+
+static void
+gtk_managed_layout_drop_tiles (GtkManagedLayout *managed_layout)
+{
+  while (managed_layout->tile_queue->head)
+    gtk_managed_layout_drop_tile (managed_layout,
+				  managed_layout->tile_queue->head->data);
+
+  /* Everything that is exposed from now on has to be drawn anyway.  */
+  managed_layout->shown.width = managed_layout->shown.height = 0;
+  gdk_region_destroy (managed_layout->uncovered);
+  managed_layout->uncovered = gdk_region_new ();
+}
+
+/* Move the bin_window to the scroll position, and remember what part
+   of the viewport the move uncovers.  Exposes there are answered from
+   the tiles; everything else that is exposed was drawn again.  */
+static void
+gtk_managed_layout_move_bin_window (GtkManagedLayout *managed_layout)
+{
+  GtkWidget *widget;
+  GdkRectangle viewport;
+  GdkRegion *region, *shown;
+
+  widget = GTK_WIDGET (managed_layout);
+  _gtk_configure_batch_move_resize (managed_layout->bin_window,
+				    - managed_layout->hadjustment->value,
+				    managed_layout->origin_y - managed_layout->scroll_y,
+				    managed_layout->width,
+				    gtk_managed_layout_get_bin_height (managed_layout));
+
+  if (!managed_layout->backing_store)
+    return;
+
+  viewport.x = managed_layout->hadjustment->value;
+  viewport.y = (gint) managed_layout->scroll_y - managed_layout->origin_y;
+  viewport.width = widget->allocation.width;
+  viewport.height = widget->allocation.height;
+
+  /* The part of the viewport that was not shown before will be
+     exposed by GDK; what scrolled out of the viewport will not.  */
+  region = gdk_region_rectangle (&viewport);
+  shown = gdk_region_rectangle (&managed_layout->shown);
+  gdk_region_subtract (region, shown);
+  gdk_region_union (managed_layout->uncovered, region);
+  gdk_region_destroy (region);
+  gdk_region_destroy (shown);
+
+  region = gdk_region_rectangle (&viewport);
+  gdk_region_intersect (managed_layout->uncovered, region);
+  gdk_region_destroy (region);
+
+  managed_layout->shown = viewport;
+}
+
+/* Drop the tiles that overlap DAMAGE, in bin_window coordinates.  */
+static void
+gtk_managed_layout_damage_tiles (GtkManagedLayout *managed_layout,
+				 GdkRegion        *damage)
+{
+  GtkManagedLayoutTile *tile;
+  GList *l, *next;
+
+  for (l = managed_layout->tile_queue->head; l; l = next)
+    {
+      next = l->next;
+      tile = l->data;
+      if (gdk_region_rect_in (damage, &tile->area) != GDK_OVERLAP_RECTANGLE_OUT)
+	gtk_managed_layout_drop_tile (managed_layout, tile);
+    }
+}
+
+/* Child windows are not drawn on the bin_window, so the tiles below
+   them cannot be copied.  */
+static gboolean
+gtk_managed_layout_tile_has_windows (GtkManagedLayout *managed_layout,
+				     GdkRectangle     *area)
+{
+  GdkRectangle rect;
+  GList *l;
+
+  for (l = gdk_window_peek_children (managed_layout->bin_window); l; l = l->next)
+    {
+      if (!gdk_window_is_visible (l->data))
+	continue;
+
+      gdk_window_get_position (l->data, &rect.x, &rect.y);
+      gdk_drawable_get_size (l->data, &rect.width, &rect.height);
+      if (gdk_rectangle_intersect (area, &rect, NULL))
+	return TRUE;
+    }
+
+  return FALSE;
+}
+
+/* Copy the tiles that are in the backing store to the bin_window, let
+   the children draw the rest, and store the tiles that were drawn
+   completely.  */
+static void
+gtk_managed_layout_expose_tiles (GtkManagedLayout *managed_layout,
+				 GdkEventExpose   *event)
+{
+  GtkWidget *widget;
+  GtkManagedLayoutTile *tile;
+  GdkEventExpose child_event;
+  GdkRegion *damage, *pending, *drawn;
+  GdkRectangle area;
+  GdkDrawable *drawable;
+  GdkPixmap *pixmap;
+  GdkGC *gc;
+  gint bin_width, bin_height;
+  gint x_offset, y_offset;
+  gint row, col, first_row, last_row, first_col, last_col;
+  guint key;
+
+  widget = GTK_WIDGET (managed_layout);
+  gc = widget->style->fg_gc[GTK_STATE_NORMAL];
+  gdk_drawable_get_size (managed_layout->bin_window, &bin_width, &bin_height);
+
+  /* Only the part that scrolling uncovered can be copied from the
+     tiles.  Anything else is exposed because it has changed, or
+     because a draw was queued on it.  */
+  damage = gdk_region_copy (event->region);
+  gdk_region_subtract (damage, managed_layout->uncovered);
+  gtk_managed_layout_damage_tiles (managed_layout, damage);
+  gdk_region_destroy (damage);
+  gdk_region_subtract (managed_layout->uncovered, event->region);
+
+  first_row = event->area.y / TILE_SIZE;
+  last_row = (event->area.y + event->area.height - 1) / TILE_SIZE;
+  first_col = event->area.x / TILE_SIZE;
+  last_col = MIN ((event->area.x + event->area.width - 1) / TILE_SIZE, 0xffff);
+
+  pending = gdk_region_copy (event->region);
+  for (row = first_row; row <= last_row; row++)
+    for (col = first_col; col <= last_col; col++)
+      {
+	key = (row << 16) | col;
+	tile = g_hash_table_lookup (managed_layout->tiles, GUINT_TO_POINTER (key));
+	if (!tile)
+	  continue;
+
+	gdk_draw_drawable (managed_layout->bin_window, gc, tile->pixmap,
+			   0, 0, tile->area.x, tile->area.y,
+			   tile->area.width, tile->area.height);
+	drawn = gdk_region_rectangle (&tile->area);
+	gdk_region_subtract (pending, drawn);
+	gdk_region_destroy (drawn);
+
+	g_queue_unlink (managed_layout->tile_queue, tile->link);
+	g_queue_push_head_link (managed_layout->tile_queue, tile->link);
+      }
+
+  if (GTK_BIN (managed_layout)->child && !gdk_region_empty (pending))
+    {
+      child_event = *event;
+      child_event.region = pending;
+      gdk_region_get_clipbox (pending, &child_event.area);
+      gtk_layoutable_propagate_expose (GTK_CONTAINER (managed_layout),
+				       GTK_BIN (managed_layout)->child,
+				       &child_event);
+    }
+
+  /* HACK!  While the expose is being processed, the content of the
+     window is in the double-buffering pixmap.  */
+  gdk_window_get_internal_paint_info (managed_layout->bin_window,
+				      &drawable, &x_offset, &y_offset);
+
+  for (row = first_row; row <= last_row; row++)
+    for (col = first_col; col <= last_col; col++)
+      {
+	area.x = col * TILE_SIZE;
+	area.y = row * TILE_SIZE;
+	area.width = MIN (TILE_SIZE, bin_width - area.x);
+	area.height = MIN (TILE_SIZE, bin_height - area.y);
+	if (area.width <= 0 || area.height <= 0
+	    || gdk_region_rect_in (pending, &area) != GDK_OVERLAP_RECTANGLE_IN
+	    || gtk_managed_layout_tile_has_windows (managed_layout, &area))
+	  continue;
+
+	pixmap = gdk_pixmap_new (managed_layout->bin_window,
+				 area.width, area.height, -1);
+	gdk_draw_drawable (pixmap, gc, drawable,
+			   area.x - x_offset, area.y - y_offset, 0, 0,
+			   area.width, area.height);
+
+	tile = g_slice_new (GtkManagedLayoutTile);
+	tile->key = (row << 16) | col;
+	tile->area = area;
+	tile->pixmap = pixmap;
+	g_queue_push_head (managed_layout->tile_queue, tile);
+	tile->link = managed_layout->tile_queue->head;
+	g_hash_table_insert (managed_layout->tiles,
+			     GUINT_TO_POINTER (tile->key), tile);
+
+	if (managed_layout->tile_queue->length > MAX_TILES)
+	  gtk_managed_layout_drop_tile (managed_layout,
+					managed_layout->tile_queue->tail->data);
+      }
+
+  gdk_region_destroy (pending);
+
+  managed_layout->shown.x = managed_layout->hadjustment->value;
+  managed_layout->shown.y = (gint) managed_layout->scroll_y - managed_layout->origin_y;
+  managed_layout->shown.width = widget->allocation.width;
+  managed_layout->shown.height = widget->allocation.height;
 }
 
 static gint 
@@ -693,8 +2250,17 @@ gtk_managed_layout_expose (GtkWidget *widget, GdkEventExpose *event)
 
   if (event->window != managed_layout->bin_window)
     return FALSE;
-  
-  (* GTK_WIDGET_CLASS (gtk_managed_layout_parent_class)->expose_event) (widget, event);
+
+  if (managed_layout->backing_store)
+    {
+      gtk_managed_layout_expose_tiles (managed_layout, event);
+      return FALSE;
+    }
+
+  /* Do not let GtkContainer walk all the children.  */
+  if (GTK_BIN (widget)->child)
+    gtk_layoutable_propagate_expose (GTK_CONTAINER (widget),
+				     GTK_BIN (widget)->child, event);
 
   return FALSE;
 }
@@ -716,18 +2282,111 @@ gtk_managed_layout_add (GtkContainer *container,
 }
 
 
+/* Move the bin_window to the current scroll position, and repaint.  */
+static void
+gtk_managed_layout_scroll (GtkManagedLayout *managed_layout)
+{
+  gboolean origin_changed;
+  gint dy;
+
+  _gtk_configure_batch_begin ();
+
+  /* When the bin_window moves to a new origin all the children have
+     to move with it.  Otherwise, bring the children that scrolled
+     into view out of the cull.  Their exact height replaces the
+     estimate, so the size of the content and the scroll position
+     may change too.  */
+  origin_changed = gtk_managed_layout_update_origin (managed_layout);
+  if (origin_changed)
+    gtk_managed_layout_drop_tiles (managed_layout);
+  if (managed_layout->freeze_count > 0)
+    managed_layout->layout_pending = TRUE;
+  else if (GTK_BIN (managed_layout)->child
+	   && (origin_changed
+	       || (managed_layout->virtualized
+		   && (managed_layout->scroll_y < managed_layout->visible_top
+		       || (managed_layout->scroll_y
+			   + managed_layout->vadjustment->page_size
+			   > managed_layout->visible_bottom)))
+	       || (managed_layout->progress_incomplete
+		   && !gtk_managed_layout_progress_covers (managed_layout))))
+    {
+      dy = gtk_managed_layout_allocate_child (managed_layout);
+
+      managed_layout->vadjustment->value =
+	MAX (managed_layout->vadjustment->value + dy, 0.);
+      managed_layout->scroll_y = MAX (managed_layout->scroll_y + dy, 0.);
+      if (!gtk_managed_layout_set_adjustment_upper (managed_layout->vadjustment,
+						    managed_layout->height, FALSE)
+	  && dy)
+	gtk_adjustment_value_changed (managed_layout->vadjustment);
+    }
+
+  /* The size may have changed together with the content.  */
+  gtk_managed_layout_move_bin_window (managed_layout);
+  _gtk_configure_batch_end ();
+  if (origin_changed && GTK_BIN (managed_layout)->child)
+    gdk_window_invalidate_rect (managed_layout->bin_window, NULL, TRUE);
+
+  gdk_window_process_updates (managed_layout->bin_window, TRUE);
+}
+
+static gboolean
+gtk_managed_layout_frame (gpointer data)
+{
+  GtkManagedLayout *managed_layout = GTK_MANAGED_LAYOUT (data);
+  gdouble distance, start;
+
+  start = _gtk_layout_stats_begin (GTK_WIDGET (managed_layout),
+				   GTK_LAYOUT_STATS_SCROLL);
+  distance = managed_layout->vadjustment->value - managed_layout->scroll_y;
+  if (managed_layout->smooth_scrolling && ABS (distance) >= 2)
+    managed_layout->scroll_y += distance * SMOOTH_SCROLLING_STEP;
+  else
+    managed_layout->scroll_y = managed_layout->vadjustment->value;
+
+  gtk_managed_layout_scroll (managed_layout);
+  _gtk_layout_stats_end (GTK_WIDGET (managed_layout), GTK_LAYOUT_STATS_SCROLL,
+			 start);
+
+  /* Keep going until the target is reached; scrolling may also have
+     moved the target.  */
+  if ((gint) managed_layout->scroll_y != (gint) managed_layout->vadjustment->value)
+    return TRUE;
+
+  managed_layout->frame_timer = 0;
+  return FALSE;
+}
+
+/* Run the frames of a pending scroll right away, until the target
+   is reached.  Used by the replay, which has to measure each scroll
+   by itself.  */
+void
+_gtk_managed_layout_flush_scroll (GtkManagedLayout *managed_layout)
+{
+  g_return_if_fail (GTK_IS_MANAGED_LAYOUT (managed_layout));
+
+  if (!managed_layout->frame_timer)
+    return;
+
+  /* frame_timer stays set until the last frame, so that scrolling
+     does not arm the timer again.  */
+  g_source_remove (managed_layout->frame_timer);
+  while (gtk_managed_layout_frame (managed_layout))
+    ;
+}
+
 /* Callbacks */
 
 static void
 gtk_managed_layout_adjustment_changed (GtkAdjustment *adjustment,
 				     GtkManagedLayout     *managed_layout)
 {
-  if (GTK_WIDGET_REALIZED (managed_layout))
-    {
-      gdk_window_move (managed_layout->bin_window,
-		       - managed_layout->hadjustment->value,
-		       - managed_layout->vadjustment->value);
-      
-      gdk_window_process_updates (managed_layout->bin_window, TRUE);
-    }
+  /* Events that arrive within the same frame are merged.  */
+  if (!GTK_WIDGET_REALIZED (managed_layout))
+    managed_layout->scroll_y = managed_layout->vadjustment->value;
+  else if (!managed_layout->frame_timer)
+    managed_layout->frame_timer =
+      gdk_threads_add_timeout (FRAME_INTERVAL, gtk_managed_layout_frame,
+			       managed_layout);
 }
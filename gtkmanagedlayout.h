@@ -54,6 +54,34 @@ struct _GtkManagedLayout
   GtkAdjustment *hadjustment;
   GtkAdjustment *vadjustment;
 
+  gint overscan;
+  gint visible_top;
+  gint visible_bottom;
+  gint origin_y;
+  gdouble scroll_y;
+  guint frame_timer;
+  guint virtualized : 1;
+  guint smooth_scrolling : 1;
+  guint backing_store : 1;
+
+  GHashTable *tiles;
+  GQueue *tile_queue;
+  GdkRectangle shown;
+  GdkRegion *uncovered;
+
+  gint layout_width;
+  gpointer async_job;
+  guint async_layout : 1;
+
+  guint freeze_count;
+  guint layout_pending : 1;
+
+  guint progressive_budget;
+  guint progress_idle;
+  gint progress_top;
+  gint progress_bottom;
+  guint progress_incomplete : 1;
+
   /*< public >*/
   GdkWindow *bin_window;
 };
@@ -77,6 +105,39 @@ void           gtk_managed_layout_set_hadjustment (GtkManagedLayout     *managed
 						 GtkAdjustment *adjustment);
 void           gtk_managed_layout_set_vadjustment (GtkManagedLayout     *managed_layout,
 						 GtkAdjustment *adjustment);
+void           gtk_managed_layout_set_virtualized (GtkManagedLayout     *managed_layout,
+						 gboolean       virtualized);
+gboolean       gtk_managed_layout_get_virtualized (GtkManagedLayout     *managed_layout);
+void           gtk_managed_layout_set_overscan    (GtkManagedLayout     *managed_layout,
+						 gint           overscan);
+gint           gtk_managed_layout_get_overscan    (GtkManagedLayout     *managed_layout);
+void           gtk_managed_layout_set_smooth_scrolling (GtkManagedLayout *managed_layout,
+						      gboolean       smooth_scrolling);
+gboolean       gtk_managed_layout_get_smooth_scrolling (GtkManagedLayout *managed_layout);
+void           gtk_managed_layout_set_backing_store (GtkManagedLayout *managed_layout,
+						   gboolean       backing_store);
+gboolean       gtk_managed_layout_get_backing_store (GtkManagedLayout *managed_layout);
+void           gtk_managed_layout_set_async_layout (GtkManagedLayout *managed_layout,
+						  gboolean       async_layout);
+gboolean       gtk_managed_layout_get_async_layout (GtkManagedLayout *managed_layout);
+void           gtk_managed_layout_set_progressive_budget (GtkManagedLayout *managed_layout,
+							guint          budget);
+guint          gtk_managed_layout_get_progressive_budget (GtkManagedLayout *managed_layout);
+gboolean       gtk_managed_layout_get_layout_complete (GtkManagedLayout *managed_layout);
+GtkWidget*     gtk_managed_layout_get_child_at_y  (GtkManagedLayout     *managed_layout,
+						 gint           y);
+void           gtk_managed_layout_scroll_to_child (GtkManagedLayout     *managed_layout,
+						 gint           nth);
+void           gtk_managed_layout_freeze_layout   (GtkManagedLayout     *managed_layout);
+void           gtk_managed_layout_thaw_layout     (GtkManagedLayout     *managed_layout);
+void           gtk_managed_layout_pack_widgets    (GtkManagedLayout     *managed_layout,
+						 GtkBox        *box,
+						 GtkWidget    **widgets,
+						 guint          n_widgets);
+
+/* Private.  */
+void           _gtk_managed_layout_flush_scroll   (GtkManagedLayout     *managed_layout);
+void           _gtk_managed_layout_flush_progress (GtkManagedLayout     *managed_layout);
 
 
 G_END_DECLS
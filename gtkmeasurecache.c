@@ -0,0 +1,306 @@
+/* gtkmeasurecache.c
+ * Copyright (C) 2008 Free Software Foundation, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Forms and logs often have many labels with the same text, so the
+   size of a PangoLayout is remembered for its text, font, wrap mode
+   and width, and the resolution and font options of its context, and
+   shared by all the labels in the process.  Layouts with attributes
+   are not cached, since the attributes cannot be compared cheaply; nor
+   are layouts that are ellipsized, justified, kept in a single
+   paragraph, or given their own spacing, indent or tabs.  The cache is only used
+   from the GTK+ thread.  */
+
+#include <string.h>
+#include <pango/pangocairo.h>
+#include "gtkmeasurecache.h"
+
+typedef struct _GtkMeasureCacheEntry GtkMeasureCacheEntry;
+
+struct _GtkMeasureCacheEntry
+{
+  /* The key.  */
+  guint hash;
+  gchar *text;
+  PangoFontDescription *font;
+  gint wrap;
+  gint width;
+  gdouble resolution;
+  gulong font_options;
+
+  GtkMeasurement measurement;
+
+  /* The link in cache_lru, most recently used first.  */
+  GList *link;
+};
+
+#define DEFAULT_MAX_ENTRIES 4096
+
+static GHashTable	*cache_table;
+static GQueue		*cache_lru;
+static guint		cache_max_entries = DEFAULT_MAX_ENTRIES;
+static guint		cache_hits;
+static guint		cache_misses;
+
+static guint
+gtk_measure_cache_entry_hash (gconstpointer p)
+{
+  const GtkMeasureCacheEntry *entry = p;
+
+  return entry->hash;
+}
+
+static gboolean
+gtk_measure_cache_entry_equal (gconstpointer a,
+			       gconstpointer b)
+{
+  const GtkMeasureCacheEntry *entry_a = a;
+  const GtkMeasureCacheEntry *entry_b = b;
+
+  return (entry_a->hash == entry_b->hash
+	  && entry_a->wrap == entry_b->wrap
+	  && entry_a->width == entry_b->width
+	  && entry_a->resolution == entry_b->resolution
+	  && entry_a->font_options == entry_b->font_options
+	  && !strcmp (entry_a->text, entry_b->text)
+	  && pango_font_description_equal (entry_a->font, entry_b->font));
+}
+
+static void
+gtk_measure_cache_entry_free (gpointer p)
+{
+  GtkMeasureCacheEntry *entry = p;
+
+  g_free (entry->text);
+  pango_font_description_free (entry->font);
+  g_slice_free (GtkMeasureCacheEntry, entry);
+}
+
+/* Fill in the key of ENTRY for LAYOUT at WIDTH, without copying
+   anything.  Return FALSE if the layout cannot be cached.  */
+static gboolean
+gtk_measure_cache_make_key (GtkMeasureCacheEntry       *entry,
+			    PangoLayout                *layout,
+			    const PangoFontDescription *font,
+			    gint                        width)
+{
+  PangoContext *context;
+  const cairo_font_options_t *options;
+
+  if (pango_layout_get_attributes (layout) || !font
+      || pango_layout_get_ellipsize (layout) != PANGO_ELLIPSIZE_NONE
+      || pango_layout_get_single_paragraph_mode (layout)
+      || pango_layout_get_justify (layout)
+      || pango_layout_get_spacing (layout) != 0
+      || pango_layout_get_indent (layout) != 0
+      || pango_layout_get_tabs (layout))
+    return FALSE;
+
+  /* The font options are compared by their hash, which packs all of
+     them into a few bits.  */
+  context = pango_layout_get_context (layout);
+  options = pango_cairo_context_get_font_options (context);
+  entry->resolution = pango_cairo_context_get_resolution (context);
+  entry->font_options = options ? cairo_font_options_hash (options) : 0;
+
+  entry->text = (gchar *) pango_layout_get_text (layout);
+  entry->font = (PangoFontDescription *) font;
+  entry->wrap = width < 0 ? -1 : pango_layout_get_wrap (layout);
+  entry->width = width;
+  entry->hash = (g_str_hash (entry->text)
+		 ^ pango_font_description_hash (font)
+		 ^ (entry->wrap * 31 + entry->width) * 17
+		 ^ entry->font_options
+		 ^ (guint) entry->resolution);
+  return TRUE;
+}
+
+static void
+gtk_measure_cache_init (void)
+{
+  if (cache_table)
+    return;
+
+  cache_table = g_hash_table_new_full (gtk_measure_cache_entry_hash,
+				       gtk_measure_cache_entry_equal,
+				       NULL, gtk_measure_cache_entry_free);
+  cache_lru = g_queue_new ();
+}
+
+static void
+gtk_measure_cache_trim (guint max_entries)
+{
+  GtkMeasureCacheEntry *entry;
+
+  while (cache_lru && cache_lru->length > max_entries)
+    {
+      entry = g_queue_pop_tail (cache_lru);
+      g_hash_table_remove (cache_table, entry);
+    }
+}
+
+/**
+ * gtk_measure_cache_set_max_entries:
+ * @max_entries: a number of entries
+ *
+ * Sets how many measurements are kept.  When the cache is full, the
+ * least recently used measurement is dropped.  With 0, nothing is
+ * cached.
+ **/
+void
+gtk_measure_cache_set_max_entries (guint max_entries)
+{
+  cache_max_entries = max_entries;
+  gtk_measure_cache_trim (max_entries);
+}
+
+/**
+ * gtk_measure_cache_get_max_entries:
+ *
+ * Returns the value set with gtk_measure_cache_set_max_entries().
+ *
+ * Return value: the maximum number of entries
+ **/
+guint
+gtk_measure_cache_get_max_entries (void)
+{
+  return cache_max_entries;
+}
+
+/**
+ * gtk_measure_cache_get_stats:
+ * @hits: return location for the number of hits, or %NULL
+ * @misses: return location for the number of misses, or %NULL
+ * @n_entries: return location for the number of entries, or %NULL
+ *
+ * Returns how many lookups were answered from the cache and how many
+ * had to be measured by Pango since the cache was last cleared, and
+ * how many measurements are in the cache.
+ **/
+void
+gtk_measure_cache_get_stats (guint *hits,
+			     guint *misses,
+			     guint *n_entries)
+{
+  if (hits)
+    *hits = cache_hits;
+  if (misses)
+    *misses = cache_misses;
+  if (n_entries)
+    *n_entries = cache_lru ? cache_lru->length : 0;
+}
+
+/**
+ * gtk_measure_cache_clear:
+ *
+ * Drops all the measurements and sets the counters back to zero.
+ **/
+void
+gtk_measure_cache_clear (void)
+{
+  gtk_measure_cache_trim (0);
+  cache_hits = cache_misses = 0;
+}
+
+/**
+ * _gtk_measure_cache_lookup:
+ * @layout: a #PangoLayout
+ * @font: the font of the widget that owns @layout
+ * @width: the width to wrap @layout at, in Pango units, or -1
+ * @measurement: return location for the measurement
+ *
+ * Looks for the size that @layout would have at @width, without
+ * changing it.  On a miss, the caller is expected to set the width on
+ * the layout and call _gtk_measure_cache_measure().
+ *
+ * Return value: %TRUE if the measurement was in the cache
+ **/
+gboolean
+_gtk_measure_cache_lookup (PangoLayout                *layout,
+			   const PangoFontDescription *font,
+			   gint                        width,
+			   GtkMeasurement             *measurement)
+{
+  GtkMeasureCacheEntry key, *entry;
+
+  if (!cache_max_entries
+      || !gtk_measure_cache_make_key (&key, layout, font, width))
+    return FALSE;
+
+  gtk_measure_cache_init ();
+  entry = g_hash_table_lookup (cache_table, &key);
+  if (!entry)
+    {
+      cache_misses++;
+      return FALSE;
+    }
+
+  g_queue_unlink (cache_lru, entry->link);
+  g_queue_push_head_link (cache_lru, entry->link);
+
+  cache_hits++;
+  *measurement = entry->measurement;
+  return TRUE;
+}
+
+/**
+ * _gtk_measure_cache_measure:
+ * @layout: a #PangoLayout
+ * @font: the font of the widget that owns @layout
+ * @measurement: return location for the measurement
+ *
+ * Measures @layout at its current width, and remembers the result.
+ **/
+void
+_gtk_measure_cache_measure (PangoLayout                *layout,
+			    const PangoFontDescription *font,
+			    GtkMeasurement             *measurement)
+{
+  GtkMeasureCacheEntry key, *entry;
+  PangoLayoutIter *iter;
+  PangoRectangle rect;
+
+  pango_layout_get_extents (layout, NULL, &rect);
+  measurement->width = rect.width;
+  measurement->height = rect.height;
+
+  iter = pango_layout_get_iter (layout);
+  pango_layout_iter_get_line_extents (iter, NULL, &rect);
+  pango_layout_iter_free (iter);
+  measurement->first_line_bottom = rect.y + rect.height;
+
+  if (!cache_max_entries
+      || !gtk_measure_cache_make_key (&key, layout, font,
+				      pango_layout_get_width (layout)))
+    return;
+
+  gtk_measure_cache_init ();
+  if (g_hash_table_lookup (cache_table, &key))
+    return;
+
+  entry = g_slice_new (GtkMeasureCacheEntry);
+  *entry = key;
+  entry->text = g_strdup (key.text);
+  entry->font = pango_font_description_copy (key.font);
+  entry->measurement = *measurement;
+
+  g_queue_push_head (cache_lru, entry);
+  entry->link = cache_lru->head;
+  g_hash_table_insert (cache_table, entry, entry);
+  gtk_measure_cache_trim (cache_max_entries);
+}
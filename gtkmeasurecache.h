@@ -0,0 +1,57 @@
+/* GTK - The GIMP Toolkit
+ * Copyright (C) 2008 Free Software Foundation, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GTK_MEASURE_CACHE_H__
+#define __GTK_MEASURE_CACHE_H__
+
+#include <glib.h>
+#include <pango/pango.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GtkMeasurement GtkMeasurement;
+
+/* The logical extents of a PangoLayout, in Pango units, and the
+   bottom of its first line.  */
+struct _GtkMeasurement
+{
+  gint width;
+  gint height;
+  gint first_line_bottom;
+};
+
+void      gtk_measure_cache_set_max_entries (guint                       max_entries);
+guint     gtk_measure_cache_get_max_entries (void);
+void      gtk_measure_cache_get_stats       (guint                      *hits,
+					     guint                      *misses,
+					     guint                      *n_entries);
+void      gtk_measure_cache_clear           (void);
+
+/* Private.  */
+gboolean  _gtk_measure_cache_lookup         (PangoLayout                *layout,
+					     const PangoFontDescription *font,
+					     gint                        width,
+					     GtkMeasurement             *measurement);
+void      _gtk_measure_cache_measure        (PangoLayout                *layout,
+					     const PangoFontDescription *font,
+					     GtkMeasurement             *measurement);
+
+G_END_DECLS
+
+#endif /* __GTK_MEASURE_CACHE_H__ */
@@ -23,6 +23,8 @@
 #include <gtk/gtk.h>
 #include "gtkresizermarshal.h"
 #include "gtkresizer.h"
+#include "gtklayoutstats.h"
+#include "gtkconfigurebatch.h"
 
 #define GTK_RESIZER_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), GTK_TYPE_RESIZER, GtkResizerPrivate))
 
@@ -582,15 +584,23 @@ static void
 update_drag (GtkResizer *resizer)
 {
   GtkResizerPrivate *priv = resizer->priv;
+  gdouble start;
   gint pos;
   gint size;
   
+  start = _gtk_layout_stats_begin (GTK_WIDGET (resizer),
+				   GTK_LAYOUT_STATS_RESIZER_DRAG);
   gtk_widget_get_pointer (GTK_WIDGET (resizer), NULL, &pos);
   size = pos - priv->drag_pos;
   size = CLAMP (size, priv->min_size, priv->max_size);
 
   if (size != priv->size)
-    gtk_resizer_set_size (resizer, size);
+    {
+      gtk_resizer_set_size (resizer, size);
+      _gtk_layout_stats_flow_start (GTK_LAYOUT_STATS_RESIZER_DRAG);
+    }
+  _gtk_layout_stats_end (GTK_WIDGET (resizer), GTK_LAYOUT_STATS_RESIZER_DRAG,
+			 start);
 }
 
 /* Why do we need the +/- 1 here?!?  */
@@ -889,14 +899,14 @@ gtk_resizer_size_allocate (GtkWidget     *widget,
 
       if (GTK_WIDGET_REALIZED (widget))
         {
-          if (GTK_WIDGET_MAPPED (widget))
+          if (GTK_WIDGET_MAPPED (widget) && !gdk_window_is_visible (priv->handle))
 	    gdk_window_show (priv->handle);
 
-          gdk_window_move_resize (priv->handle,
-			          priv->handle_pos.x,
-			          priv->handle_pos.y,
-			          priv->handle_pos.width,
-			          priv->handle_pos.height);
+          _gtk_configure_batch_move_resize (priv->handle,
+					    priv->handle_pos.x,
+					    priv->handle_pos.y,
+					    priv->handle_pos.width,
+					    priv->handle_pos.height);
 	}
 
       child_allocation.x = allocation->x + border_width;
@@ -0,0 +1,541 @@
+/* Benchmark for GtkManagedLayout and the layoutable widgets.
+ *
+ * Copyright (C) 2008 Free Software Foundation, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Builds a synthetic tree of widgets inside a GtkManagedLayout, lays
+   it out at a range of widths and prints the time spent in each phase
+   as one JSON object per line.  Run it under Xvfb to get numbers that
+   do not depend on the desktop, as "make bench" does.  */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <gtk/gtk.h>
+#include "gtkmanagedlayout.h"
+#include "gtklayoutable.h"
+#include "gtklayoutstats.h"
+#include "gtklayoutrecorder.h"
+#include "gtklayoutengine.h"
+#include "gtkmeasurecache.h"
+#include "gtkconfigurebatch.h"
+#include "gtkellipsis.h"
+#include "gtkresizer.h"
+
+static gchar *shape = "wide";
+static gint count = 1000;
+static gint depth = 50;
+static gint min_width = 200;
+static gint max_width = 1000;
+static gint width_step = 100;
+static gint height = 600;
+static gint repeat = 3;
+static gboolean virtualized = FALSE;
+static gboolean stats = FALSE;
+static gchar *trace = NULL;
+static gchar *record = NULL;
+static gboolean headless = FALSE;
+static gint threads = 1;
+static gboolean bulk = FALSE;
+static gint budget = 0;
+
+static GOptionEntry entries[] =
+{
+  { "shape", 's', 0, G_OPTION_ARG_STRING, &shape,
+    "Shape of the tree: deep, wide, ellipsis or resizer", "SHAPE" },
+  { "count", 'n', 0, G_OPTION_ARG_INT, &count,
+    "Number of children of wide trees", "N" },
+  { "depth", 'd', 0, G_OPTION_ARG_INT, &depth,
+    "Nesting depth of deep trees", "N" },
+  { "min-width", 0, 0, G_OPTION_ARG_INT, &min_width,
+    "First width of the sweep", "PIXELS" },
+  { "max-width", 0, 0, G_OPTION_ARG_INT, &max_width,
+    "Last width of the sweep", "PIXELS" },
+  { "step", 0, 0, G_OPTION_ARG_INT, &width_step,
+    "Increment of the width during the sweep", "PIXELS" },
+  { "height", 0, 0, G_OPTION_ARG_INT, &height,
+    "Height of the viewport", "PIXELS" },
+  { "repeat", 'r', 0, G_OPTION_ARG_INT, &repeat,
+    "Number of sweeps", "N" },
+  { "virtualized", 'v', 0, G_OPTION_ARG_NONE, &virtualized,
+    "Only lay out the visible children", NULL },
+  { "stats", 0, 0, G_OPTION_ARG_NONE, &stats,
+    "Print the layout statistics for each widget type", NULL },
+  { "trace", 't', 0, G_OPTION_ARG_FILENAME, &trace,
+    "Write a Chrome trace of the layout passes to FILE", "FILE" },
+  { "record", 0, 0, G_OPTION_ARG_FILENAME, &record,
+    "Record the sweeps to FILE, for layoutreplay", "FILE" },
+  { "headless", 0, 0, G_OPTION_ARG_NONE, &headless,
+    "Lay out GtkLayoutNodes with fake font metrics, without a display", NULL },
+  { "threads", 0, 0, G_OPTION_ARG_INT, &threads,
+    "Measure large boxes with N threads in --headless mode", "N" },
+  { "bulk", 0, 0, G_OPTION_ARG_NONE, &bulk,
+    "Add the children of wide trees with gtk_managed_layout_pack_widgets", NULL },
+  { "budget", 0, 0, G_OPTION_ARG_INT, &budget,
+    "Lay out progressively, USEC microseconds at a time", "USEC" },
+  { NULL }
+};
+
+static const gchar *words[] = {
+  "lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipisci",
+  "velit", "sed", "quia", "non", "numquam", "eius", "modi", "tempora"
+};
+
+/* A deterministic paragraph of N words, so that runs are comparable.  */
+static gchar *
+make_text (gint n, gint seed)
+{
+  GString *str;
+  gint i;
+
+  str = g_string_new (NULL);
+  for (i = 0; i < n; i++)
+    {
+      if (i)
+	g_string_append_c (str, ' ');
+      g_string_append (str, words[(seed * 7 + i * 3) % G_N_ELEMENTS (words)]);
+    }
+
+  return g_string_free (str, FALSE);
+}
+
+static GtkWidget *
+make_label (gint seed)
+{
+  GtkWidget *label;
+  gchar *text;
+
+  text = make_text (5 + (seed * 13) % 60, seed);
+  label = gtk_label_new (text);
+  gtk_label_set_line_wrap (GTK_LABEL (label), TRUE);
+  g_free (text);
+  return label;
+}
+
+/* Alternate vertical and horizontal boxes, each holding a label and
+   the next level.  */
+static GtkWidget *
+make_deep_tree (gint level)
+{
+  GtkWidget *box;
+
+  box = (level % 2) ? gtk_hbox_new (FALSE, 2) : gtk_vbox_new (FALSE, 2);
+  gtk_box_pack_start (GTK_BOX (box), make_label (level), FALSE, FALSE, 0);
+  if (level < depth)
+    gtk_box_pack_start (GTK_BOX (box), make_deep_tree (level + 1),
+			TRUE, TRUE, 0);
+
+  return box;
+}
+
+static GtkWidget *
+make_wide_tree (void)
+{
+  GtkWidget *vbox;
+  gint i;
+
+  vbox = gtk_vbox_new (FALSE, 4);
+  for (i = 0; i < count; i++)
+    gtk_box_pack_start (GTK_BOX (vbox), make_label (i), FALSE, FALSE, 0);
+
+  return vbox;
+}
+
+/* Like make_wide_tree, but the box is put in LAYOUT first and the
+   labels are added all at once.  */
+static GtkWidget *
+make_wide_tree_bulk (GtkManagedLayout *layout)
+{
+  GtkWidget *vbox;
+  GtkWidget **labels;
+  gint i;
+
+  vbox = gtk_vbox_new (FALSE, 4);
+  gtk_container_add (GTK_CONTAINER (layout), vbox);
+
+  labels = g_new (GtkWidget *, count);
+  for (i = 0; i < count; i++)
+    labels[i] = make_label (i);
+
+  gtk_managed_layout_pack_widgets (layout, GTK_BOX (vbox), labels, count);
+  g_free (labels);
+  return vbox;
+}
+
+static GtkWidget *
+make_ellipsis_tree (void)
+{
+  GtkWidget *vbox;
+  GtkWidget *ellipsis;
+  gchar *text;
+  gint i;
+
+  vbox = gtk_vbox_new (FALSE, 4);
+  for (i = 0; i < count; i++)
+    {
+      text = make_text (5 + (i * 13) % 30, i);
+      ellipsis = gtk_ellipsis_new (text);
+      g_free (text);
+
+      gtk_container_add (GTK_CONTAINER (ellipsis), make_label (i));
+      gtk_box_pack_start (GTK_BOX (vbox), ellipsis, FALSE, FALSE, 0);
+    }
+
+  return vbox;
+}
+
+static GtkWidget *
+make_resizer_tree (gint level)
+{
+  GtkWidget *resizer;
+  GtkWidget *hbox;
+
+  resizer = gtk_resizer_new ();
+  hbox = gtk_hbox_new (FALSE, 2);
+  gtk_container_add (GTK_CONTAINER (resizer), hbox);
+  gtk_box_pack_start (GTK_BOX (hbox), make_label (level), TRUE, TRUE, 0);
+  if (level < depth)
+    gtk_box_pack_start (GTK_BOX (hbox), make_resizer_tree (level + 1),
+			FALSE, TRUE, 0);
+
+  return resizer;
+}
+
+static GtkWidget *
+make_tree (void)
+{
+  if (!strcmp (shape, "deep"))
+    return make_deep_tree (0);
+  if (!strcmp (shape, "wide"))
+    return make_wide_tree ();
+  if (!strcmp (shape, "ellipsis"))
+    return make_ellipsis_tree ();
+  if (!strcmp (shape, "resizer"))
+    {
+      GtkWidget *vbox;
+      vbox = gtk_vbox_new (FALSE, 0);
+      gtk_box_pack_start (GTK_BOX (vbox), make_resizer_tree (0),
+			  FALSE, FALSE, 0);
+      return vbox;
+    }
+
+  return NULL;
+}
+
+/* The same trees as nodes for the headless engine.  Ellipses and
+   resizers have no equivalent.  */
+static GtkLayoutNode *
+make_deep_nodes (gint level)
+{
+  GtkLayoutNode *node;
+  gchar *text;
+
+  node = (level % 2) ? gtk_layout_node_new_hbox (2) : gtk_layout_node_new_vbox (2);
+  text = make_text (5 + (level * 13) % 60, level);
+  gtk_layout_node_append (node, gtk_layout_node_new_text (text, TRUE), 0, FALSE);
+  g_free (text);
+  if (level < depth)
+    gtk_layout_node_append (node, make_deep_nodes (level + 1), 0, FALSE);
+
+  return node;
+}
+
+static GtkLayoutNode *
+make_nodes (void)
+{
+  GtkLayoutNode *node;
+  gchar *text;
+  gint i;
+
+  if (!strcmp (shape, "deep"))
+    return make_deep_nodes (0);
+  if (strcmp (shape, "wide"))
+    return NULL;
+
+  node = gtk_layout_node_new_vbox (4);
+  for (i = 0; i < count; i++)
+    {
+      text = make_text (5 + (i * 13) % 60, i);
+      gtk_layout_node_append (node, gtk_layout_node_new_text (text, TRUE),
+			      0, FALSE);
+      g_free (text);
+    }
+
+  return node;
+}
+
+static glong
+peak_rss (void)
+{
+  struct rusage usage;
+
+  getrusage (RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+static void
+print_type_stats (GType                 type,
+		  const GtkLayoutStats *type_stats,
+		  gpointer              user_data)
+{
+  printf ("{\"type\": \"%s\", "
+	  "\"request_calls\": %u, \"request_us\": %.0f, "
+	  "\"allocate_calls\": %u, \"allocate_us\": %.0f, "
+	  "\"pango_layout_calls\": %u, \"pango_layout_us\": %.0f, "
+	  "\"expose_calls\": %u, \"expose_us\": %.0f}\n",
+	  g_type_name (type),
+	  type_stats->calls[GTK_LAYOUT_STATS_REQUEST],
+	  type_stats->time[GTK_LAYOUT_STATS_REQUEST] * 1e6,
+	  type_stats->calls[GTK_LAYOUT_STATS_ALLOCATE],
+	  type_stats->time[GTK_LAYOUT_STATS_ALLOCATE] * 1e6,
+	  type_stats->calls[GTK_LAYOUT_STATS_PANGO_LAYOUT],
+	  type_stats->time[GTK_LAYOUT_STATS_PANGO_LAYOUT] * 1e6,
+	  type_stats->calls[GTK_LAYOUT_STATS_EXPOSE],
+	  type_stats->time[GTK_LAYOUT_STATS_EXPOSE] * 1e6);
+}
+
+static void
+run_sweep (GtkWidget *layout, gint pass)
+{
+  GtkRequisition requisition;
+  GtkAllocation allocation;
+  GTimer *timer;
+  gdouble request_time, allocate_time, fill_time, expose_time;
+  gint width;
+
+  timer = g_timer_new ();
+  for (width = min_width; width <= max_width; width += width_step)
+    {
+      /* Force the whole tree to be measured again.  */
+      gtk_widget_queue_resize (GTK_BIN (layout)->child);
+
+      g_timer_start (timer);
+      gtk_widget_size_request (layout, &requisition);
+      request_time = g_timer_elapsed (timer, NULL);
+
+      allocation.x = allocation.y = 0;
+      allocation.width = width;
+      allocation.height = height;
+      g_timer_start (timer);
+      gtk_widget_size_allocate (layout, &allocation);
+      allocate_time = g_timer_elapsed (timer, NULL);
+
+      /* The time to finish the progressive layout.  Only its slices
+	 are run: the main loop would also run the resize of the
+	 toplevel, and lay out everything again at the window's width.  */
+      g_timer_start (timer);
+      _gtk_managed_layout_flush_progress (GTK_MANAGED_LAYOUT (layout));
+      fill_time = g_timer_elapsed (timer, NULL);
+
+      g_timer_start (timer);
+      gdk_window_invalidate_rect (layout->window, NULL, TRUE);
+      gdk_window_process_updates (layout->window, TRUE);
+      gdk_flush ();
+      expose_time = g_timer_elapsed (timer, NULL);
+
+      printf ("{\"shape\": \"%s\", \"count\": %d, \"depth\": %d, "
+	      "\"virtualized\": %s, \"budget\": %d, \"pass\": %d, "
+	      "\"width\": %d, \"height\": %d, \"request_us\": %.0f, "
+	      "\"allocate_us\": %.0f, \"fill_us\": %.0f, \"expose_us\": %.0f}\n",
+	      shape, count, depth, virtualized ? "true" : "false", budget,
+	      pass, width, GTK_MANAGED_LAYOUT (layout)->height,
+	      request_time * 1e6, allocate_time * 1e6, fill_time * 1e6,
+	      expose_time * 1e6);
+    }
+
+  g_timer_destroy (timer);
+}
+
+static int
+run_headless (void)
+{
+  GtkLayoutEngine *engine;
+  GtkLayoutNode *root;
+  GTimer *timer;
+  gdouble build_time, allocate_time;
+  gint i, width;
+
+  timer = g_timer_new ();
+  root = make_nodes ();
+  if (!root)
+    {
+      fprintf (stderr, "shape %s is not supported by --headless\n", shape);
+      return 1;
+    }
+
+  build_time = g_timer_elapsed (timer, NULL);
+  engine = gtk_layout_engine_new_fake (7, 16);
+  for (i = 1; i < threads; i++)
+    gtk_layout_engine_add_helper (engine, gtk_layout_engine_new_fake (7, 16));
+
+  for (i = 0; i < repeat; i++)
+    for (width = min_width; width <= max_width; width += width_step)
+      {
+	g_timer_start (timer);
+	gtk_layout_engine_allocate (engine, root, 0, 0, width);
+	allocate_time = g_timer_elapsed (timer, NULL);
+
+	printf ("{\"shape\": \"%s\", \"count\": %d, \"depth\": %d, "
+		"\"headless\": true, \"threads\": %d, \"pass\": %d, "
+		"\"width\": %d, \"height\": %d, \"allocate_us\": %.0f}\n",
+		shape, count, depth, threads, i, width, root->height,
+		allocate_time * 1e6);
+      }
+
+  printf ("{\"shape\": \"%s\", \"count\": %d, \"depth\": %d, "
+	  "\"headless\": true, \"build_us\": %.0f, \"peak_rss_kb\": %ld}\n",
+	  shape, count, depth, build_time * 1e6, peak_rss ());
+
+  gtk_layout_engine_free (engine);
+  gtk_layout_node_free (root);
+  g_timer_destroy (timer);
+  return 0;
+}
+
+int main (int argc, char **argv)
+{
+  GtkWidget *window;
+  GtkWidget *layout;
+  GtkWidget *tree;
+  GtkLayoutRecorder *recorder = NULL;
+  GOptionContext *context;
+  GError *error = NULL;
+  GTimer *timer;
+  gdouble build_time;
+  gint i;
+
+  if (!g_thread_supported ())
+    g_thread_init (NULL);
+
+  /* Do not open the display yet, --headless does not need one.  */
+  context = g_option_context_new ("- layout benchmark");
+  g_option_context_add_main_entries (context, entries, NULL);
+  g_option_context_add_group (context, gtk_get_option_group (FALSE));
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      fprintf (stderr, "%s\n", error->message);
+      return 1;
+    }
+
+  g_option_context_free (context);
+  if (width_step <= 0 || min_width <= 0 || max_width < min_width)
+    {
+      fprintf (stderr, "invalid width sweep\n");
+      return 1;
+    }
+  if (budget < 0)
+    {
+      fprintf (stderr, "invalid budget\n");
+      return 1;
+    }
+
+  if (headless)
+    return run_headless ();
+
+  if (!gtk_init_check (&argc, &argv))
+    {
+      fprintf (stderr, "cannot open display\n");
+      return 1;
+    }
+
+  gtk_layoutable_init ();
+  if (stats)
+    gtk_layout_stats_set_enabled (TRUE);
+  if (trace && !gtk_layout_stats_set_trace_file (trace))
+    {
+      fprintf (stderr, "cannot open %s\n", trace);
+      return 1;
+    }
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  layout = gtk_managed_layout_new (NULL, NULL);
+  gtk_managed_layout_set_virtualized (GTK_MANAGED_LAYOUT (layout),
+				      virtualized);
+  gtk_managed_layout_set_progressive_budget (GTK_MANAGED_LAYOUT (layout),
+					     budget);
+  gtk_container_add (GTK_CONTAINER (window), layout);
+
+  timer = g_timer_new ();
+  if (bulk && !strcmp (shape, "wide"))
+    tree = make_wide_tree_bulk (GTK_MANAGED_LAYOUT (layout));
+  else
+    {
+      tree = make_tree ();
+      if (!tree)
+	{
+	  fprintf (stderr, "unknown shape %s\n", shape);
+	  return 1;
+	}
+
+      gtk_container_add (GTK_CONTAINER (layout), tree);
+    }
+
+  build_time = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+
+  gtk_window_set_default_size (GTK_WINDOW (window), min_width, height);
+  gtk_widget_show_all (window);
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+
+  if (record)
+    {
+      recorder = gtk_layout_recorder_new (GTK_MANAGED_LAYOUT (layout),
+					  record, &error);
+      if (!recorder)
+	{
+	  fprintf (stderr, "%s\n", error->message);
+	  return 1;
+	}
+    }
+
+  gtk_layout_stats_reset ();
+  gtk_configure_batch_reset_stats ();
+  for (i = 0; i < repeat; i++)
+    run_sweep (layout, i);
+
+  if (recorder)
+    gtk_layout_recorder_free (recorder);
+
+  if (stats)
+    {
+      guint hits, misses, n_entries;
+      guint n_calls, n_requests;
+
+      gtk_layout_stats_foreach_type (print_type_stats, NULL);
+      gtk_measure_cache_get_stats (&hits, &misses, &n_entries);
+      printf ("{\"measure_cache_hits\": %u, \"measure_cache_misses\": %u, "
+	      "\"measure_cache_entries\": %u}\n", hits, misses, n_entries);
+      gtk_configure_batch_get_stats (&n_calls, &n_requests);
+      printf ("{\"configure_calls\": %u, \"configure_requests\": %u, "
+	      "\"configure_saved\": %u}\n", n_calls, n_requests, n_calls - n_requests);
+    }
+
+  printf ("{\"shape\": \"%s\", \"count\": %d, \"depth\": %d, "
+	  "\"virtualized\": %s, \"bulk\": %s, \"build_us\": %.0f, "
+	  "\"peak_rss_kb\": %ld}\n",
+	  shape, count, depth, virtualized ? "true" : "false",
+	  bulk ? "true" : "false", build_time * 1e6, peak_rss ());
+
+  gtk_widget_destroy (window);
+  if (trace)
+    gtk_layout_stats_set_trace_file (NULL);
+  return 0;
+}
@@ -0,0 +1,109 @@
+/* Replay a recording made with GtkLayoutRecorder.
+ *
+ * Copyright (C) 2008 Free Software Foundation, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Rebuilds the tree in the recording, applies its events as fast as
+   possible and prints the time spent on each kind of event as a JSON
+   object.  Each event is followed by the layout and drawing that it
+   causes, so the numbers include the work done in idle handlers.  */
+
+#include <stdio.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <gtk/gtk.h>
+#include "gtklayoutable.h"
+#include "gtklayoutrecorder.h"
+
+static const gchar *const event_names[GTK_LAYOUT_EVENT_N_TYPES] = {
+  "allocate",
+  "scroll",
+  "label_text",
+  "ellipsis_expanded",
+  "resizer_size"
+};
+
+int main (int argc, char **argv)
+{
+  GtkLayoutReplay *replay;
+  GtkLayoutEventType type;
+  GtkWidget *window;
+  GtkWidget *layout;
+  GError *error = NULL;
+  GTimer *timer;
+  struct rusage usage;
+  guint calls[GTK_LAYOUT_EVENT_N_TYPES] = { 0 };
+  gdouble times[GTK_LAYOUT_EVENT_N_TYPES] = { 0 };
+  gdouble start, total;
+  gint i;
+
+  gtk_init (&argc, &argv);
+  gtk_layoutable_init ();
+
+  if (argc != 2)
+    {
+      fprintf (stderr, "usage: %s RECORDING\n", argv[0]);
+      return 1;
+    }
+
+  replay = gtk_layout_replay_new (argv[1], &error);
+  if (!replay)
+    {
+      fprintf (stderr, "%s\n", error->message);
+      return 1;
+    }
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  layout = gtk_layout_replay_get_layout (replay);
+  gtk_container_add (GTK_CONTAINER (window), layout);
+  gtk_window_set_default_size (GTK_WINDOW (window), 800, 600);
+  gtk_widget_show (layout);
+  gtk_widget_show (window);
+  while (gtk_events_pending ())
+    gtk_main_iteration ();
+
+  timer = g_timer_new ();
+  for (;;)
+    {
+      start = g_timer_elapsed (timer, NULL);
+      if (!gtk_layout_replay_step (replay, &type))
+	break;
+
+      while (gtk_events_pending ())
+	gtk_main_iteration ();
+      gdk_window_process_all_updates ();
+
+      calls[type]++;
+      times[type] += g_timer_elapsed (timer, NULL) - start;
+    }
+
+  total = g_timer_elapsed (timer, NULL);
+  getrusage (RUSAGE_SELF, &usage);
+
+  printf ("{\"recording\": \"%s\", \"total_us\": %.0f", argv[1], total * 1e6);
+  for (i = 0; i < GTK_LAYOUT_EVENT_N_TYPES; i++)
+    printf (", \"%s_events\": %u, \"%s_us\": %.0f",
+	    event_names[i], calls[i], event_names[i], times[i] * 1e6);
+  printf (", \"peak_rss_kb\": %ld}\n", usage.ru_maxrss);
+
+  g_timer_destroy (timer);
+  gtk_widget_destroy (window);
+  gtk_layout_replay_free (replay);
+  return 0;
+}